@@ -0,0 +1,355 @@
+/*
+ * File: benchmark.cpp
+ * Author: Jeremy Ephron
+ * ---------------------
+ * Times the solver on a fixed corpus of puzzles, so that changes to the
+ * search can be compared run against run:
+ *
+ *     ./benchmark [-d dictionary] [-t threads] [-r repeats] [-o file]
+ *
+ * Every puzzle of the corpus is solved for one word up to its most words,
+ * with every engine, both enumerating its solutions (into a stream that
+ * discards them) and counting them. The dp engine counts without searching,
+ * so it counts every puzzle up to kMaxWords words.
+ *
+ * Each run is timed in two phases, filtering the dictionary down to a
+ * WordGraph and solving, and reports the solutions found per second of
+ * solving, the peak resident set size of the run and how busy the threads
+ * of the pool were while solving (the CPU time used over the wall time of
+ * every thread). With repeats, the fastest of the repeats is reported.
+ *
+ * The report is written as JSON to the file given, or to standard output.
+ * `make bench` runs the benchmark and writes it to build/benchmark.json.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <getopt.h>
+#include <sys/resource.h>
+#include "dictionaryindex.h"
+#include "letterbox.h"
+#include "search.h"
+#include "solutionset.h"
+#include "solutionstream.h"
+#include "taskpool.h"
+#include "word.h"
+#include "wordgraph.h"
+
+using Clock = std::chrono::steady_clock;
+using Millis = std::chrono::duration<double, std::milli>;
+
+static const std::string DEFAULT_INDEX = "dictionary.idx";
+
+/* The most words per solution of any run. */
+static const unsigned int kMaxWords = 4;
+
+/* A puzzle of the corpus. */
+struct BenchPuzzle {
+    const char *letters;
+    unsigned int maxWords;  // the most words per solution searched for
+};
+
+// From sparse to dense: the four word solutions of the last three number in
+// the hundreds of millions, so only the smaller ones are searched at n = 4.
+static const BenchPuzzle kCorpus[] = {
+    {"WLYRAMOICUNT", 4},
+    {"GIYHCTLAOPRE", 4},
+    {"ZXHAEIRSOUNT", 3},
+    {"NUBCRAILOEPT", 3},
+    {"RMOAILTNHGSU", 3},
+};
+
+static const struct {
+    const char *name;
+    SearchOptions::Engine engine;
+} kEngines[] = {
+    {"dfs", SearchOptions::kDfs},
+    {"join", SearchOptions::kJoin},
+    {"dp", SearchOptions::kDp},
+};
+
+static const struct {
+    const char *name;
+    SearchOptions::Query query;
+} kQueries[] = {
+    {"all", SearchOptions::kAll},
+    {"count", SearchOptions::kCount},
+};
+
+/* The measurements of a run. */
+struct BenchResult {
+    uint64_t nSolutions = 0;
+    double filterMillis = 0;   // building the WordGraph of the puzzle
+    double solveMillis = 0;    // searching it
+    double utilization = 0;    // CPU time over wall time of every thread
+    long peakRssKb = 0;        // the peak resident set size of the run
+};
+
+/* The settings given on the command line. */
+struct BenchOptions {
+    std::string dictionary;
+    std::string output;
+    size_t nThreads = 0;
+    unsigned int nRepeats = 1;
+};
+
+/**
+ * Function: parseOptions
+ * ----------------------
+ * Parses the command line flags into options.
+ *
+ * @param argc the number of arguments.
+ * @param argv the arguments.
+ * @param options the options to populate.
+ * @returns whether the flags were valid.
+ */
+bool parseOptions(int argc, char *argv[], BenchOptions &options);
+
+/**
+ * Function: runPuzzle
+ * -------------------
+ * Filters the dictionary for a puzzle and solves it once.
+ *
+ * @param dictionary the loaded dictionary to use.
+ * @param letters the letters of the puzzle.
+ * @param nWords the number of words per solution.
+ * @param search how to search.
+ * @param pool the pool the search tasks are run on.
+ * @returns the measurements of the run.
+ */
+BenchResult runPuzzle(const DictionaryIndex &dictionary,
+                      const std::string &letters, unsigned int nWords,
+                      const SearchOptions &search, TaskPool &pool);
+
+/**
+ * Function: resetPeakRss
+ * ----------------------
+ * Resets the peak resident set size of the process to its current size, so
+ * that the next run reports a peak of its own.
+ *
+ * @returns whether the peak could be reset (it can on Linux only).
+ */
+bool resetPeakRss();
+
+/**
+ * Function: peakRssKb
+ * -------------------
+ * Returns the peak resident set size of the process in kilobytes, since the
+ * last resetPeakRss() if it succeeded.
+ */
+long peakRssKb();
+
+/**
+ * Function: cpuSeconds
+ * --------------------
+ * Returns the user and system time used by every thread of the process.
+ */
+double cpuSeconds();
+
+/**
+ * Function: writeReport
+ * ---------------------
+ * Writes the report of the benchmark as JSON.
+ *
+ * @param out the stream to write it to.
+ * @param options the settings of the benchmark.
+ * @param nThreads the number of threads searching.
+ * @param loadMillis the time taken to load the dictionary.
+ * @param perRunRss whether the peak RSS of each run is its own, rather than
+ *                  the peak of the process so far.
+ * @param runs the runs of the benchmark, one JSON object each.
+ */
+void writeReport(std::ostream &out, const BenchOptions &options,
+                 size_t nThreads, double loadMillis, bool perRunRss,
+                 const std::vector<std::string> &runs);
+
+int main(int argc, char *argv[]) {
+    BenchOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        std::cerr << "Usage: " << argv[0] << " [-d dictionary] [-t threads]"
+                  << " [-r repeats] [-o file]" << std::endl;
+        return 1;
+    }
+
+    auto start = Clock::now();
+    DictionaryIndex dictionary(options.dictionary);
+    if (!dictionary.isOpen()) {
+        std::cerr << "Could not load dictionary \"" << options.dictionary
+                  << "\"." << std::endl;
+        return 1;
+    }
+    double loadMillis = Millis(Clock::now() - start).count();
+
+    TaskPool pool(options.nThreads);
+    bool perRunRss = resetPeakRss();
+    std::vector<std::string> runs;
+    for (const BenchPuzzle &puzzle : kCorpus) {
+        for (unsigned int n = 1; n <= kMaxWords; n++) {
+            for (const auto &engine : kEngines) {
+                for (const auto &query : kQueries) {
+                    bool dpCount = engine.engine == SearchOptions::kDp &&
+                                   query.query == SearchOptions::kCount;
+                    if (n > puzzle.maxWords && !dpCount) continue;
+
+                    SearchOptions search;
+                    search.engine = engine.engine;
+                    search.query = query.query;
+
+                    BenchResult best;
+                    for (unsigned int i = 0; i < options.nRepeats; i++) {
+                        BenchResult result = runPuzzle(
+                            dictionary, puzzle.letters, n, search, pool);
+                        long peak = std::max(best.peakRssKb,
+                                             result.peakRssKb);
+                        if (i == 0 || result.solveMillis < best.solveMillis) {
+                            best = result;
+                        }
+                        best.peakRssKb = peak;
+                    }
+
+                    double seconds = best.solveMillis / 1000;
+                    std::ostringstream run;
+                    run << "{\"letters\": \"" << puzzle.letters
+                        << "\", \"words\": " << n
+                        << ", \"engine\": \"" << engine.name
+                        << "\", \"query\": \"" << query.name
+                        << "\", \"solutions\": " << best.nSolutions
+                        << ", \"filter_ms\": " << best.filterMillis
+                        << ", \"solve_ms\": " << best.solveMillis
+                        << ", \"solutions_per_s\": "
+                        << (seconds > 0 ? best.nSolutions / seconds : 0)
+                        << ", \"thread_utilization\": " << best.utilization
+                        << ", \"peak_rss_kb\": " << best.peakRssKb << "}";
+                    runs.push_back(run.str());
+
+                    std::cerr << puzzle.letters << " " << n << " "
+                              << engine.name << " " << query.name << ": "
+                              << best.nSolutions << " solution(s), filter "
+                              << best.filterMillis << " ms, solve "
+                              << best.solveMillis << " ms" << std::endl;
+                }
+            }
+        }
+    }
+
+    if (options.output.empty()) {
+        writeReport(std::cout, options, pool.numThreads(), loadMillis,
+                    perRunRss, runs);
+        return 0;
+    }
+
+    std::ofstream out(options.output);
+    if (!out) {
+        std::cerr << "Could not open \"" << options.output << "\"."
+                  << std::endl;
+        return 1;
+    }
+    writeReport(out, options, pool.numThreads(), loadMillis, perRunRss,
+                runs);
+    return 0;
+}
+
+bool parseOptions(int argc, char *argv[], BenchOptions &options) {
+    int opt;
+    while ((opt = getopt(argc, argv, "d:t:r:o:h")) != -1) {
+        switch (opt) {
+            case 'd': options.dictionary = optarg; break;
+            case 't':
+                options.nThreads = std::strtoul(optarg, nullptr, 10);
+                break;
+            case 'r':
+                options.nRepeats = std::strtoul(optarg, nullptr, 10);
+                if (options.nRepeats == 0) return false;
+                break;
+            case 'o': options.output = optarg; break;
+            default:
+                return false;
+        }
+    }
+
+    if (optind != argc) return false;
+    if (options.dictionary.empty()) options.dictionary = DEFAULT_INDEX;
+    return true;
+}
+
+BenchResult runPuzzle(const DictionaryIndex &dictionary,
+                      const std::string &letters, unsigned int nWords,
+                      const SearchOptions &search, TaskPool &pool) {
+    BenchResult result;
+    resetPeakRss();
+
+    auto start = Clock::now();
+    LetterBox letterBox(letters);
+    WordTable wordsStartingWith;
+    buildFilteredWordList(dictionary, letterBox, wordsStartingWith);
+    WordGraph graph(letterBox, wordsStartingWith);
+    auto filtered = Clock::now();
+
+    // Solutions are written out as they would be, then thrown away.
+    std::ostream discard(nullptr);
+    double cpuStart = cpuSeconds();
+    {
+        SolutionStream stream(discard);
+        result.nSolutions = solvePuzzle(graph, nWords, search, pool, &stream);
+        stream.close();
+    }
+    auto solved = Clock::now();
+    double cpu = cpuSeconds() - cpuStart;
+
+    result.filterMillis = Millis(filtered - start).count();
+    result.solveMillis = Millis(solved - filtered).count();
+    double wall = result.solveMillis / 1000 * pool.numThreads();
+    result.utilization = wall > 0 ? std::min(cpu / wall, 1.0) : 0;
+    result.peakRssKb = peakRssKb();
+    return result;
+}
+
+bool resetPeakRss() {
+    std::ofstream clearRefs("/proc/self/clear_refs");
+    clearRefs << "5" << std::flush;
+    return bool(clearRefs);
+}
+
+long peakRssKb() {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (getline(status, line)) {
+        if (line.compare(0, 6, "VmHWM:") == 0) {
+            return std::strtol(line.c_str() + 6, nullptr, 10);
+        }
+    }
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+double cpuSeconds() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+           (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+void writeReport(std::ostream &out, const BenchOptions &options,
+                 size_t nThreads, double loadMillis, bool perRunRss,
+                 const std::vector<std::string> &runs) {
+    out << "{\n"
+        << "  \"dictionary\": \"" << options.dictionary << "\",\n"
+        << "  \"threads\": " << nThreads << ",\n"
+        << "  \"repeats\": " << options.nRepeats << ",\n"
+        << "  \"load_ms\": " << loadMillis << ",\n"
+        << "  \"peak_rss_per_run\": " << (perRunRss ? "true" : "false")
+        << ",\n"
+        << "  \"runs\": [\n";
+    for (size_t i = 0; i < runs.size(); i++) {
+        out << "    " << runs[i] << (i + 1 < runs.size() ? ",\n" : "\n");
+    }
+    out << "  ]\n}" << std::endl;
+}
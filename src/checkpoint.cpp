@@ -0,0 +1,200 @@
+/*
+ * File: checkpoint.cpp
+ * Author: Jeremy Ephron
+ * --------------------
+ * The implementation of the Checkpoint class.
+ *
+ * The file is a few lines of text:
+ *
+ *     letterboxed-checkpoint 1
+ *     key <the key of the search>
+ *     output <bytes of output>
+ *     found <solutions written or counted>
+ *     done <task or first-last range> ...
+ *     written <task>:<solutions> ...
+ */
+
+#include "checkpoint.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
+
+using Clock = std::chrono::steady_clock;
+
+const std::chrono::seconds Checkpoint::kDefaultInterval(10);
+const char *const Checkpoint::kMagic = "letterboxed-checkpoint 1";
+
+Checkpoint::Checkpoint(const std::string &filename, const std::string &key,
+                       std::chrono::seconds interval)
+    : filename(filename), key(key), interval(interval), resumed(false),
+      outputBytes(0), nFound(0), nextSave(Clock::now() + interval) {}
+
+bool Checkpoint::load(std::string &error) {
+    std::ifstream in(filename);
+    if (!in) return true;
+
+    // Reads "<name> <rest of the line>", the rest left in value.
+    std::string line, value;
+    auto field = [&](const std::string &name) {
+        if (!getline(in, line) || line.compare(0, name.size(), name) != 0 ||
+            (line.size() > name.size() && line[name.size()] != ' ')) {
+            return false;
+        }
+        value = line.size() > name.size() ? line.substr(name.size() + 1) : "";
+        return true;
+    };
+
+    unsigned long long outputSize = 0, found = 0;
+    if (!getline(in, line) || line != kMagic || !field("key")) {
+        error = "\"" + filename + "\" is not a checkpoint";
+        return false;
+    }
+    if (value != key) {
+        error = "\"" + filename + "\" is the checkpoint of another search";
+        return false;
+    }
+    if (!field("output") || !(std::istringstream(value) >> outputSize) ||
+        !field("found") || !(std::istringstream(value) >> found) ||
+        !field("done")) {
+        error = "\"" + filename + "\" is corrupt";
+        return false;
+    }
+
+    std::istringstream ranges(value);
+    std::string range;
+    while (ranges >> range) {
+        unsigned long long first, last;
+        char dash;
+        std::istringstream parts(range);
+        if (!(parts >> first)) {
+            error = "\"" + filename + "\" is corrupt";
+            return false;
+        }
+        last = first;
+        if (parts >> dash && (dash != '-' || !(parts >> last) ||
+                              last < first)) {
+            error = "\"" + filename + "\" is corrupt";
+            return false;
+        }
+        for (Task task = first; task <= last; task++) {
+            doneBefore.insert(task);
+        }
+    }
+
+    if (!field("written")) {
+        error = "\"" + filename + "\" is corrupt";
+        return false;
+    }
+    std::istringstream counts(value);
+    std::string count;
+    while (counts >> count) {
+        unsigned long long task, nWritten;
+        char colon;
+        std::istringstream parts(count);
+        if (!(parts >> task >> colon >> nWritten) || colon != ':') {
+            error = "\"" + filename + "\" is corrupt";
+            return false;
+        }
+        writtenBefore[task] = nWritten;
+    }
+
+    std::lock_guard<std::mutex> lg(lock);
+    resumed = true;
+    done.assign(doneBefore.begin(), doneBefore.end());
+    written = writtenBefore;
+    outputBytes = outputSize;
+    nFound = found;
+    return true;
+}
+
+bool Checkpoint::isResumed() const {
+    return this->resumed;
+}
+
+uint64_t Checkpoint::outputSize() const {
+    std::lock_guard<std::mutex> lg(lock);
+    return this->outputBytes;
+}
+
+uint64_t Checkpoint::numFound() const {
+    std::lock_guard<std::mutex> lg(lock);
+    return this->nFound;
+}
+
+void Checkpoint::setOutput(std::function<uint64_t()> sync) {
+    std::lock_guard<std::mutex> lg(lock);
+    this->sync = std::move(sync);
+}
+
+bool Checkpoint::save() {
+    std::lock_guard<std::mutex> lg(lock);
+    return saveLocked();
+}
+
+bool Checkpoint::saveLocked() {
+    if (sync) outputBytes = sync();
+    nextSave = Clock::now() + interval;
+
+    std::sort(done.begin(), done.end());
+    std::string temporary = filename + "." + std::to_string(getpid());
+    {
+        std::ofstream out(temporary);
+        out << kMagic << "\n"
+            << "key " << key << "\n"
+            << "output " << outputBytes << "\n"
+            << "found " << nFound << "\n"
+            << "done";
+        for (size_t i = 0; i < done.size(); ) {
+            size_t end = i + 1;
+            while (end < done.size() && done[end] == done[end - 1] + 1) end++;
+            out << " " << done[i];
+            if (end - i > 1) out << "-" << done[end - 1];
+            i = end;
+        }
+        out << "\nwritten";
+        for (const auto &task : written) {
+            if (task.second == 0) continue;
+            out << " " << task.first << ":" << task.second;
+        }
+        out << "\n";
+        if (!out) {
+            std::remove(temporary.c_str());
+            return false;
+        }
+    }
+    return std::rename(temporary.c_str(), filename.c_str()) == 0;
+}
+
+void Checkpoint::saveIfDue() {
+    if (Clock::now() >= nextSave) saveLocked();
+}
+
+bool Checkpoint::isDone(Task task) const {
+    return doneBefore.count(task) != 0;
+}
+
+uint64_t Checkpoint::numWritten(Task task) const {
+    auto found = writtenBefore.find(task);
+    return found == writtenBefore.end() ? 0 : found->second;
+}
+
+void Checkpoint::recordWritten(Task task, size_t nSolutions, bool isDone) {
+    std::lock_guard<std::mutex> lg(lock);
+    nFound += nSolutions;
+    if (isDone) {
+        written.erase(task);
+        done.push_back(task);
+    } else {
+        written[task] += nSolutions;
+    }
+    saveIfDue();
+}
+
+void Checkpoint::recordCount(Task task, uint64_t nSolutions) {
+    std::lock_guard<std::mutex> lg(lock);
+    nFound += nSolutions;
+    done.push_back(task);
+    saveIfDue();
+}
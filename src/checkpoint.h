@@ -0,0 +1,126 @@
+/*
+ * File: checkpoint.h
+ * Author: Jeremy Ephron
+ * --------------------
+ * The interface for the Checkpoint class, which keeps how far an exhaustive
+ * search has got in a small file, so that a search that was stopped, or
+ * whose process was killed, can be resumed rather than started over.
+ *
+ * The work is counted in the tasks of generateSolutions: a first word, or a
+ * first and second word for solutions of four or more words. A checkpoint
+ * holds the tasks that are done, and for every other task the number of its
+ * solutions already written, which a resumed task skips: a task always finds
+ * its solutions in the same order, however many threads share the search.
+ * It also holds the size the output had once they were written, which the
+ * output is to be truncated to before a resumed search appends to it, so
+ * that no solution is written twice.
+ *
+ * What the output holds is only known on the writer thread of the
+ * SolutionStream, which tells the checkpoint of every batch of a task it has
+ * written. For a count query there is no output, and each task adds its
+ * count once it is done. The file is rewritten at most once per interval, by
+ * the thread that records something once it is due, and once more when
+ * asked to after the search; each time through a temporary file renamed
+ * over the old one, so that it is never left half written.
+ */
+
+#ifndef Search_Checkpoint
+#define Search_Checkpoint
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+class Checkpoint {
+public:  /* Interface */
+
+    using Task = uint64_t;
+
+    /**
+     * Keeps a checkpoint of the search key describes (the puzzle, query and
+     * anything else its tasks depend on) in filename, every interval.
+     */
+    Checkpoint(const std::string &filename, const std::string &key,
+               std::chrono::seconds interval = kDefaultInterval);
+
+    /**
+     * Reads the checkpoint file to resume from it, if there is one.
+     *
+     * @returns false with the problem in error if it could not be read or is
+     *          the checkpoint of another search.
+     */
+    bool load(std::string &error);
+
+    /** Returns true if load() found a checkpoint to resume from. */
+    bool isResumed() const;
+
+    /** Returns the size the output had when the checkpoint was taken. */
+    uint64_t outputSize() const;
+
+    /** Returns the solutions written (or counted) so far, by every run. */
+    uint64_t numFound() const;
+
+    /**
+     * Sets how to flush the output to the file and get its size, which is
+     * called before every save, on the writer thread of the stream.
+     */
+    void setOutput(std::function<uint64_t()> sync);
+
+    /** Writes the checkpoint file now, returning false if it could not. */
+    bool save();
+
+private:
+
+    /** Writes the checkpoint file, with lock held. */
+    bool saveLocked();
+
+    /** Saves the checkpoint if the interval has passed, with lock held. */
+    void saveIfDue();
+
+    std::string filename;
+    std::string key;
+    std::chrono::seconds interval;
+    std::function<uint64_t()> sync;
+
+    // As loaded, and only read during the search.
+    bool resumed;
+    std::unordered_set<Task> doneBefore;
+    std::unordered_map<Task, uint64_t> writtenBefore;
+
+    mutable std::mutex lock;  // guards everything below
+    std::vector<Task> done;
+    std::unordered_map<Task, uint64_t> written;  // of the tasks not done
+    uint64_t outputBytes;
+    uint64_t nFound;
+    std::chrono::steady_clock::time_point nextSave;
+
+public:  /* used by the search, not necessary for most users */
+
+    /** Returns true if a task was done when the checkpoint was loaded. */
+    bool isDone(Task task) const;
+
+    /**
+     * Returns the solutions of a task that were written before the
+     * checkpoint was loaded, which the task is to skip.
+     */
+    uint64_t numWritten(Task task) const;
+
+    /** Counts solutions of a task as written, and the task as done. */
+    void recordWritten(Task task, size_t nSolutions, bool isDone);
+
+    /** Counts a task of a count query as done, with its count. */
+    void recordCount(Task task, uint64_t nSolutions);
+
+    static const std::chrono::seconds kDefaultInterval;
+    static const char *const kMagic;
+
+    Checkpoint(const Checkpoint &) = delete;
+    Checkpoint &operator=(const Checkpoint &) = delete;
+};
+
+#endif
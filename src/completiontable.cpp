@@ -0,0 +1,91 @@
+/*
+ * File: completiontable.cpp
+ * Author: Jeremy Ephron
+ * --------------------------
+ * The implementation of the CompletionTable class.
+ */
+
+#include "completiontable.h"
+#include <algorithm>
+
+const size_t CompletionTable::kMaxDenseLetters = 14;
+const uint64_t CompletionTable::kUnknown = UINT64_MAX;
+
+CompletionTable::CompletionTable(const WordGraph &graph, unsigned int nWords)
+    : CompletionTable(graph, nWords, nWords) {}
+
+CompletionTable::CompletionTable(const WordGraph &graph, unsigned int minWords,
+                                 unsigned int nWords)
+    : graph(graph), numLetters(graph.numLetters()), nSolutions(nWords + 1) {
+    if (nWords == 0) return;
+
+    if (numLetters <= kMaxDenseLetters) {
+        dense.assign(size_t(nWords) * numLetters << numLetters, kUnknown);
+    }
+
+    for (unsigned int n = std::max(minWords, 1u); n <= nWords; n++) {
+        for (size_t first = 0; first < numLetters; first++) {
+            nSolutions[n] += solve(n, first, graph.fullMask());
+        }
+    }
+}
+
+uint64_t CompletionTable::total() const {
+    uint64_t sum = 0;
+    for (uint64_t n : nSolutions) sum += n;
+    return sum;
+}
+
+uint64_t CompletionTable::total(unsigned int nWords) const {
+    return nWords < nSolutions.size() ? nSolutions[nWords] : 0;
+}
+
+uint64_t CompletionTable::count(unsigned int nWords, size_t first,
+                                LetterMask remaining) const {
+    if (nWords == 0) return remaining == 0 ? 1 : 0;
+
+    uint64_t value;
+    if (!dense.empty()) {
+        value = dense[key(nWords, first, remaining)];
+    } else {
+        auto found = sparse.find(key(nWords, first, remaining));
+        value = found == sparse.end() ? kUnknown : found->second;
+    }
+    return value == kUnknown ? 0 : value;
+}
+
+uint64_t CompletionTable::solve(unsigned int nWords, size_t first,
+                                LetterMask remaining) {
+    if (nWords == 0) return remaining == 0 ? 1 : 0;
+
+    uint64_t slot = key(nWords, first, remaining);
+    if (!dense.empty()) {
+        if (dense[slot] != kUnknown) return dense[slot];
+    } else {
+        auto found = sparse.find(slot);
+        if (found != sparse.end()) return found->second;
+    }
+
+    uint64_t completions = 0;
+    for (auto node = graph.begin(first); node != graph.end(first); node++) {
+        LetterMask left = remaining & ~node->mask;
+        if (nWords == 1) {
+            if (left == 0) completions += node->size();
+            continue;
+        }
+        completions += node->size() * solve(nWords - 1, node->last, left);
+    }
+
+    if (!dense.empty()) {
+        dense[slot] = completions;
+    } else {
+        sparse[slot] = completions;
+    }
+    return completions;
+}
+
+uint64_t CompletionTable::key(unsigned int nWords, size_t first,
+                              LetterMask remaining) const {
+    uint64_t state = uint64_t(nWords - 1) * numLetters + first;
+    return state << numLetters | remaining;
+}
@@ -0,0 +1,84 @@
+/*
+ * File: completiontable.h
+ * Author: Jeremy Ephron
+ * ------------------------
+ * The interface for the CompletionTable class, which counts the ways a
+ * search can be completed from each of its states.
+ *
+ * Which words can still follow in a search depends only on the number of
+ * words left, the letter the next word must start with and the letters not
+ * yet covered, not on the words that led there. The table memoizes, for each
+ * such state reachable from the empty path, how many sequences of words
+ * complete it. A state with no completions is a dead subtree, so a search
+ * guided by the table never enters one, and counting the solutions of a
+ * puzzle is a sum over the first words.
+ *
+ * Since a state does not depend on how it was reached, one table can be
+ * filled for every number of words from minWords to nWords, sharing the
+ * states the searches of each have in common, as an incremental search of
+ * solutions of up to nWords words needs.
+ *
+ * For boxes of at most kMaxDenseLetters letters the states are kept in a
+ * dense array indexed by (words left, letter, mask); larger boxes use a hash
+ * table holding only the states reached.
+ */
+
+#ifndef Completion_Table
+#define Completion_Table
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "letterbox.h"
+#include "wordgraph.h"
+
+class CompletionTable {
+public:  /* Interface */
+
+    /** Fills the table for solutions of nWords words of a graph. */
+    CompletionTable(const WordGraph &graph, unsigned int nWords);
+
+    /**
+     * Fills the table for solutions of every number of words from minWords
+     * to nWords of a graph.
+     */
+    CompletionTable(const WordGraph &graph, unsigned int minWords,
+                    unsigned int nWords);
+
+    /** Returns the number of solutions of every number of words filled. */
+    uint64_t total() const;
+
+    /** Returns the number of solutions of nWords words, if filled. */
+    uint64_t total(unsigned int nWords) const;
+
+    /**
+     * Returns the number of ways nWords words, the first starting with the
+     * letter index first, can cover every letter of remaining. Only states
+     * reachable from the empty path are known; any other state counts 0.
+     */
+    uint64_t count(unsigned int nWords, size_t first,
+                   LetterMask remaining) const;
+
+private:
+
+    /** Computes (and memoizes) the count of a state. */
+    uint64_t solve(unsigned int nWords, size_t first, LetterMask remaining);
+
+    /** Returns the key of a state in the dense or the sparse table. */
+    uint64_t key(unsigned int nWords, size_t first,
+                 LetterMask remaining) const;
+
+    const WordGraph &graph;
+    size_t numLetters;
+    std::vector<uint64_t> nSolutions;  // indexed by the number of words
+
+    std::vector<uint64_t> dense;
+    std::unordered_map<uint64_t, uint64_t> sparse;
+
+public:  /* public, but not necessary for most users */
+
+    static const size_t kMaxDenseLetters;
+    static const uint64_t kUnknown;
+};
+
+#endif
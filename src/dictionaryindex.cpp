@@ -0,0 +1,276 @@
+/*
+ * File: dictionaryindex.cpp
+ * Author: Jeremy Ephron
+ * --------------------------
+ * The implementation of the DictionaryIndex class.
+ */
+
+#include "dictionaryindex.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const size_t kAlphabetSize = 26;
+
+struct DictionaryIndex::Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t numWords;
+    uint32_t textSize;
+
+    // Words starting with 'A' + i are entries [offsets[i], offsets[i + 1]).
+    uint32_t letterOffsets[kAlphabetSize + 1];
+};
+
+const char DictionaryIndex::kMagic[8] = {'L', 'B', 'X', 'I', 'D', 'X', 0, 0};
+const uint32_t DictionaryIndex::kVersion = 2;
+const size_t DictionaryIndex::kTextPadding = 64;
+const size_t DictionaryIndex::kMinChunkSize = 1 << 20;
+
+/* Returns true if the word is non-empty and made only of 'A' to 'Z'. */
+static bool isIndexable(const std::string &word) {
+    if (word.empty() || word.size() > UINT8_MAX) return false;
+    for (char ch : word) {
+        if (ch < 'A' || ch > 'Z') return false;
+    }
+    return true;
+}
+
+/* The indexable words of one chunk of a text dictionary, by first letter. */
+struct DictionaryIndex::Chunk {
+    std::vector<Entry> entries[kAlphabetSize];  // offsets into text
+    std::string text[kAlphabetSize];
+};
+
+void DictionaryIndex::parseChunk(const char *begin, const char *end,
+                                 Chunk &chunk) {
+    std::string word;
+    while (begin < end) {
+        const char *newline = static_cast<const char *>(
+            std::memchr(begin, '\n', end - begin));
+        const char *lineEnd = newline == nullptr ? end : newline;
+
+        word.assign(begin, lineEnd);
+        begin = lineEnd + 1;
+
+        if (!word.empty() && word.back() == '\r') word.pop_back();
+        for (char &ch : word) ch = toupper(static_cast<unsigned char>(ch));
+        if (!isIndexable(word)) continue;
+
+        size_t letter = word[0] - 'A';
+        Entry entry;
+        entry.offset = chunk.text[letter].size();
+        entry.alphabetMask = 0;
+        for (char ch : word) entry.alphabetMask |= uint32_t(1) << (ch - 'A');
+        entry.length = word.size();
+        entry.first = word.front();
+        entry.last = word.back();
+        entry.nUniqueLetters = __builtin_popcount(entry.alphabetMask);
+
+        chunk.entries[letter].push_back(entry);
+        chunk.text[letter] += word;
+    }
+}
+
+bool DictionaryIndex::compile(const std::string &dictFilename,
+                              std::vector<char> &image) {
+    int fd = open(dictFilename.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return false;
+    }
+
+    size_t size = st.st_size;
+    const char *text = nullptr;
+    if (size > 0) {
+        void *p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED) {
+            close(fd);
+            return false;
+        }
+        text = static_cast<const char *>(p);
+    }
+    close(fd);
+
+    // Split the text into a chunk per thread, each ending after a newline,
+    // so that no line is split between two chunks.
+    size_t nChunks = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    nChunks = std::min(nChunks, size / kMinChunkSize + 1);
+    std::vector<size_t> bounds(nChunks + 1, size);
+    bounds[0] = 0;
+    for (size_t i = 1; i < nChunks; i++) {
+        size_t at = std::max(size * i / nChunks, bounds[i - 1]);
+        const void *newline = at < size
+            ? std::memchr(text + at, '\n', size - at) : nullptr;
+        bounds[i] = newline == nullptr
+            ? size : static_cast<const char *>(newline) - text + 1;
+    }
+
+    std::vector<Chunk> chunks(nChunks);
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < nChunks; i++) {
+        threads.emplace_back(parseChunk, text + bounds[i],
+                             text + bounds[i + 1], std::ref(chunks[i]));
+    }
+    parseChunk(text, text + bounds[1], chunks[0]);
+    for (std::thread &thread : threads) thread.join();
+
+    if (text != nullptr) munmap(const_cast<char *>(text), size);
+
+    // Merge the chunks, keeping the words with the same first letter in the
+    // order they appear in the file.
+    Header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+
+    std::vector<Entry> entries;
+    std::vector<uint32_t> masks;
+    std::string blob;
+    for (size_t letter = 0; letter < kAlphabetSize; letter++) {
+        for (const Chunk &chunk : chunks) {
+            uint32_t base = blob.size();
+            for (Entry entry : chunk.entries[letter]) {
+                entry.offset += base;
+                entries.push_back(entry);
+                masks.push_back(entry.alphabetMask);
+            }
+            blob += chunk.text[letter];
+        }
+        header.letterOffsets[letter + 1] = entries.size();
+    }
+    header.numWords = entries.size();
+    header.textSize = blob.size();
+
+    const char *p = reinterpret_cast<const char *>(&header);
+    image.assign(p, p + sizeof(header));
+    p = reinterpret_cast<const char *>(masks.data());
+    image.insert(image.end(), p, p + masks.size() * sizeof(uint32_t));
+    p = reinterpret_cast<const char *>(entries.data());
+    image.insert(image.end(), p, p + entries.size() * sizeof(Entry));
+    image.insert(image.end(), blob.begin(), blob.end());
+    image.insert(image.end(), kTextPadding, 0);
+
+    return true;
+}
+
+bool DictionaryIndex::build(const std::string &dictFilename,
+                            const std::string &indexFilename) {
+    std::vector<char> image;
+    if (!compile(dictFilename, image)) return false;
+
+    std::ofstream out(indexFilename, std::ios::binary);
+    if (!out) return false;
+
+    out.write(image.data(), image.size());
+    return bool(out);
+}
+
+bool DictionaryIndex::isIndexFile(const std::string &filename) {
+    std::ifstream in(filename, std::ios::binary);
+    char magic[sizeof(kMagic)];
+    if (!in.read(magic, sizeof(magic))) return false;
+    return std::memcmp(magic, kMagic, sizeof(kMagic)) == 0;
+}
+
+DictionaryIndex::DictionaryIndex(const std::string &filename)
+    : header(nullptr), masks(nullptr), entries(nullptr), blob(nullptr),
+      mapping(nullptr), mappingSize(0) {
+    if (!isIndexFile(filename)) {
+        if (compile(filename, image)) attach(image.data(), image.size());
+        return;
+    }
+
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) return;
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && size_t(st.st_size) >= sizeof(Header)) {
+        void *p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED) {
+            mapping = p;
+            mappingSize = st.st_size;
+        }
+    }
+    close(fd);
+
+    if (mapping != nullptr) attach(mapping, mappingSize);
+}
+
+uint64_t DictionaryIndex::fingerprint() const {
+    const char *data = mapping != nullptr
+                       ? static_cast<const char *>(mapping) : image.data();
+    size_t size = mapping != nullptr ? mappingSize : image.size();
+
+    // FNV-1a, as for the hash of a Word.
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ static_cast<unsigned char>(data[i])) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+void DictionaryIndex::attach(const void *image, size_t size) {
+    if (size < sizeof(Header)) return;
+
+    const Header *h = static_cast<const Header *>(image);
+    size_t expected = sizeof(Header) +
+                      size_t(h->numWords) * (sizeof(uint32_t) + sizeof(Entry)) +
+                      h->textSize + kTextPadding;
+    if (std::memcmp(h->magic, kMagic, sizeof(kMagic)) != 0 ||
+        h->version != kVersion || expected > size ||
+        h->letterOffsets[kAlphabetSize] != h->numWords) {
+        return;
+    }
+
+    header = h;
+    masks = reinterpret_cast<const uint32_t *>(h + 1);
+    entries = reinterpret_cast<const Entry *>(masks + h->numWords);
+    blob = reinterpret_cast<const char *>(entries + h->numWords);
+}
+
+DictionaryIndex::~DictionaryIndex() {
+    if (mapping != nullptr) munmap(mapping, mappingSize);
+}
+
+bool DictionaryIndex::isOpen() const {
+    return this->header != nullptr;
+}
+
+size_t DictionaryIndex::numWords() const {
+    return this->header->numWords;
+}
+
+const DictionaryIndex::Entry *DictionaryIndex::begin(char first) const {
+    if (first < 'A' || first > 'Z') return this->entries;
+    return this->entries + this->header->letterOffsets[first - 'A'];
+}
+
+const DictionaryIndex::Entry *DictionaryIndex::end(char first) const {
+    if (first < 'A' || first > 'Z') return this->entries;
+    return this->entries + this->header->letterOffsets[first - 'A' + 1];
+}
+
+const char *DictionaryIndex::text(const Entry &entry) const {
+    return this->blob + entry.offset;
+}
+
+uint32_t DictionaryIndex::id(const Entry &entry) const {
+    return &entry - this->entries;
+}
+
+const uint32_t *DictionaryIndex::alphabetMasks() const {
+    return this->masks;
+}
@@ -0,0 +1,132 @@
+/*
+ * File: dictionaryindex.h
+ * Author: Jeremy Ephron
+ * --------------------------
+ * The interface for the DictionaryIndex class. A dictionary index is a binary
+ * file compiled once from a text dictionary (one word per line) that can be
+ * memory mapped and filtered for a LetterBox without parsing.
+ *
+ * The file holds a header, the alphabet mask of every word, an array of
+ * entries grouped by first letter, and the text of every word packed into a
+ * single blob. Words are uppercased, and only words made entirely of the
+ * letters 'A' to 'Z' are indexed.
+ *
+ * The masks repeat those of the entries as a plain array, so that a filter
+ * can reject many words per instruction, and the blob is followed by
+ * kTextPadding zero bytes, so that the text of any word can be loaded into
+ * a vector register without reading past the end of the index.
+ *
+ * A text dictionary can also be loaded directly, in which case the same
+ * layout is built in memory. Either way a DictionaryIndex is read-only once
+ * loaded and can be shared by any number of puzzles and threads.
+ */
+
+#ifndef Dictionary_Index
+#define Dictionary_Index
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class DictionaryIndex {
+public:  /* Interface */
+
+    /** The precomputed facts about a single word of the dictionary. */
+    struct Entry {
+        uint32_t offset;         // offset of the word in the text blob
+        uint32_t alphabetMask;   // letters used, bit 0 for 'A'
+        uint8_t length;
+        char first;
+        char last;
+        uint8_t nUniqueLetters;
+    };
+
+    /**
+     * Compiles the text dictionary dictFilename into an index file.
+     *
+     * @returns true on success, false if either file could not be opened.
+     */
+    static bool build(const std::string &dictFilename,
+                      const std::string &indexFilename);
+
+    /** Returns true if the file exists and starts with the index header. */
+    static bool isIndexFile(const std::string &filename);
+
+    /**
+     * Memory maps an index file, or loads a text dictionary into memory if
+     * the file is not an index. Check isOpen() before using it.
+     */
+    DictionaryIndex(const std::string &filename);
+
+    /** Returns true if the index was loaded and its header is valid. */
+    bool isOpen() const;
+
+    /** Returns the number of words in the index. */
+    size_t numWords() const;
+
+    /** Returns the range of entries of words starting with a letter. */
+    const Entry *begin(char first) const;
+    const Entry *end(char first) const;
+
+    /** Returns a pointer to the (not null terminated) text of a word. */
+    const char *text(const Entry &entry) const;
+
+    /** Returns the position of an entry in the index, stable across runs. */
+    uint32_t id(const Entry &entry) const;
+
+    /**
+     * Returns the alphabet masks of every entry, in the same order: the mask
+     * of entry e is alphabetMasks()[id(e)].
+     */
+    const uint32_t *alphabetMasks() const;
+
+    /**
+     * Returns a hash of the whole index, the same for a text dictionary and
+     * the index built from it. Reads every byte, so callers should keep it.
+     */
+    uint64_t fingerprint() const;
+
+private:
+
+    struct Header;
+    struct Chunk;
+
+    /**
+     * Builds the index file image of a text dictionary into image. The file
+     * is memory mapped and split on line boundaries into a chunk per
+     * hardware thread, which are parsed in parallel and merged in order.
+     */
+    static bool compile(const std::string &dictFilename,
+                        std::vector<char> &image);
+
+    /** Parses the lines of text in [begin, end) into a chunk. */
+    static void parseChunk(const char *begin, const char *end, Chunk &chunk);
+
+    /** Points header, entries and blob into an image, if it is valid. */
+    void attach(const void *image, size_t size);
+
+    const Header *header;
+    const uint32_t *masks;
+    const Entry *entries;
+    const char *blob;
+
+    // The index is either memory mapped, or owned in memory.
+    void *mapping;
+    size_t mappingSize;
+    std::vector<char> image;
+
+    static const char kMagic[8];
+    static const uint32_t kVersion;
+
+public:  /* public, but not necessary for most users */
+
+    static const size_t kTextPadding;
+    static const size_t kMinChunkSize;
+
+    ~DictionaryIndex();
+
+    DictionaryIndex(const DictionaryIndex &) = delete;
+    DictionaryIndex &operator=(const DictionaryIndex &) = delete;
+};
+
+#endif
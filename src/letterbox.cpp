@@ -6,60 +6,86 @@
  */
 
 #include "letterbox.h"
+#include <algorithm>
+#include <vector>
 
 const size_t LetterBox::kNumWalls = 4;
 const size_t LetterBox::kMinWordLength = 3;
+const size_t LetterBox::kMaxLetters = sizeof(LetterMask) * 8;
+const uint8_t LetterBox::kNone = 0xFF;
+
+/* Table lookups are indexed by unsigned char so non-ASCII input is safe. */
+static inline uint8_t lookup(const std::array<uint8_t, 256> &table, char ch) {
+    return table[static_cast<unsigned char>(ch)];
+}
+
+LetterBox::LetterBox(const std::string &letters)
+    : walls(letters), lettersPerWall(letters.size() / kNumWalls), alphabet(0) {
+    this->letterToWall.fill(kNone);
+    this->letterToIndex.fill(kNone);
 
-LetterBox::LetterBox(const std::string &letters) {
-    unsigned int lettersPerWord = letters.size() / kNumWalls;
     for (unsigned int wallNum = 0; wallNum < kNumWalls; wallNum++) {
-        std::vector<char> *p_wall = new std::vector<char>;
-
-        for (size_t i = 0; i < lettersPerWord; i++) {
-            size_t idx = wallNum * lettersPerWord + i;
-            p_wall->push_back(letters[idx]);
-            this->letters.insert(letters[idx]);
-            if (letterToWall.count(letters[idx]) == 0) {
-                letterToWall[letters[idx]] = p_wall;
-            }
+        for (size_t i = 0; i < lettersPerWall; i++) {
+            char ch = letters[wallNum * lettersPerWall + i];
+            unsigned char key = static_cast<unsigned char>(ch);
+            if (letterToWall[key] != kNone) continue;
+
+            letterToWall[key] = wallNum;
+            letterToIndex[key] = this->letters.size();
+            this->letters.push_back(ch);
+            if (ch >= 'A' && ch <= 'Z') alphabet |= uint32_t(1) << (ch - 'A');
         }
-
-        this->letterWalls.push_back(p_wall);
     }
 }
 
-LetterBox::~LetterBox() {
-    for (auto ptr : this->letterWalls) delete ptr;
-}
-
-std::unordered_set<char> LetterBox::getLetters() const {
+const std::string &LetterBox::getLetters() const {
     return this->letters;
 }
 
-std::vector<char> *LetterBox::getWall(char letter) const {
-    return this->letterToWall.find(letter)->second;
+std::string LetterBox::canonicalLetters() const {
+    std::vector<std::string> sorted;
+    for (size_t i = 0; i < kNumWalls; i++) {
+        sorted.push_back(walls.substr(i * lettersPerWall, lettersPerWall));
+        std::sort(sorted.back().begin(), sorted.back().end());
+    }
+    std::sort(sorted.begin(), sorted.end());
+
+    std::string canonical;
+    for (const std::string &wall : sorted) canonical += wall;
+    return canonical;
 }
 
-bool LetterBox::onSameWall(char letter1, char letter2) const {
-    auto iter1 = this->letterToWall.find(letter1);
-    if (iter1 == this->letterToWall.end()) return false;
+std::string LetterBox::getWall(char letter) const {
+    uint8_t wall = lookup(this->letterToWall, letter);
+    if (wall == kNone) return "";
+    return this->walls.substr(wall * lettersPerWall, lettersPerWall);
+}
 
-    auto iter2 = this->letterToWall.find(letter2);
-    if (iter2 == this->letterToWall.end()) return false;
+uint8_t LetterBox::wallIndex(char letter) const {
+    return lookup(this->letterToWall, letter);
+}
 
-    return iter1->second == iter2->second;
+bool LetterBox::onSameWall(char letter1, char letter2) const {
+    uint8_t wall1 = lookup(this->letterToWall, letter1);
+    return wall1 != kNone && wall1 == lookup(this->letterToWall, letter2);
 }
 
 bool LetterBox::contains(char letter) const {
-    return this->letters.count(letter) > 0;
+    return lookup(this->letterToWall, letter) != kNone;
 }
 
 bool LetterBox::canMakeWord(const std::string &word) const {
-    if (word.length() < kMinWordLength) return false;
+    return canMakeWord(word.data(), word.length());
+}
 
-    for (size_t i = 0; i < word.length(); i++) {
-        if (!contains(word[i]) || (i > 0 && onSameWall(word[i - 1], word[i])))
-            return false;
+bool LetterBox::canMakeWord(const char *word, size_t length) const {
+    if (length < kMinWordLength) return false;
+
+    uint8_t prev = kNone;
+    for (size_t i = 0; i < length; i++) {
+        uint8_t wall = lookup(this->letterToWall, word[i]);
+        if ((wall == kNone) | (wall == prev)) return false;
+        prev = wall;
     }
 
     return true;
@@ -69,3 +95,29 @@ size_t LetterBox::numLetters() const {
     return this->letters.size();
 }
 
+size_t LetterBox::letterIndex(char letter) const {
+    return lookup(this->letterToIndex, letter);
+}
+
+LetterMask LetterBox::letterMask(const std::string &word) const {
+    return letterMask(word.data(), word.length());
+}
+
+LetterMask LetterBox::letterMask(const char *word, size_t length) const {
+    LetterMask mask = 0;
+    for (size_t i = 0; i < length; i++) {
+        uint8_t index = lookup(this->letterToIndex, word[i]);
+        if (index != kNone) mask |= LetterMask(1) << index;
+    }
+
+    return mask;
+}
+
+LetterMask LetterBox::fullMask() const {
+    size_t n = numLetters();
+    return n >= kMaxLetters ? ~LetterMask(0) : (LetterMask(1) << n) - 1;
+}
+
+uint32_t LetterBox::alphabetMask() const {
+    return this->alphabet;
+}
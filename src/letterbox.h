@@ -11,10 +11,15 @@
 #ifndef Letter_Box
 #define Letter_Box
 
+#include <array>
+#include <cstdint>
 #include <string>
-#include <vector>
-#include <unordered_map>
-#include <unordered_set>
+
+/**
+ * A set of letters of a LetterBox, one bit per letter. Bit i is set when the
+ * letter with dense index i (see LetterBox::letterIndex) is in the set.
+ */
+using LetterMask = uint32_t;
 
 class LetterBox {
 public:  /* Interface */
@@ -22,11 +27,24 @@ public:  /* Interface */
     /** Creates a LetterBox puzzle from a string of letters. */
     LetterBox(const std::string &letters);
 
-    /** Returns the set of all letters of the LetterBox puzzle. */
-    std::unordered_set<char> getLetters() const;
+    /** Returns all letters of the LetterBox puzzle, each once, by index. */
+    const std::string &getLetters() const;
+
+    /**
+     * Returns the letters of the box in canonical form: the letters of each
+     * wall sorted, then the walls sorted. Boxes with the same walls, in any
+     * order, have the same canonical form and the same solutions.
+     */
+    std::string canonicalLetters() const;
 
-    /** Returns a pointer to the "wall" that a letter belongs to. */
-    std::vector<char> *getWall(char letter) const;
+    /** Returns the letters of the "wall" that a letter belongs to. */
+    std::string getWall(char letter) const;
+
+    /**
+     * Returns the index (0 to kNumWalls - 1) of the wall a letter belongs to,
+     * or kNone if it is not in the Letter Box.
+     */
+    uint8_t wallIndex(char letter) const;
 
     /** Returns true if two letters are on the same wall, false otherwise. */
     bool onSameWall(char letter1, char letter2) const;
@@ -36,27 +54,53 @@ public:  /* Interface */
 
     /** Returns true if a word can be written within the Letter Box. */
     bool canMakeWord(const std::string &word) const;
+    bool canMakeWord(const char *word, size_t length) const;
 
     /** Returns the number of letters in the Letter Box. */
     size_t numLetters() const;
 
+    /**
+     * Returns the dense index (0 to numLetters() - 1) of a letter in the
+     * Letter Box, assigned in the order the letters were given.
+     */
+    size_t letterIndex(char letter) const;
+
+    /** Returns the mask of the Letter Box letters used in a word. */
+    LetterMask letterMask(const std::string &word) const;
+    LetterMask letterMask(const char *word, size_t length) const;
+
+    /** Returns the mask with every letter of the Letter Box set. */
+    LetterMask fullMask() const;
+
+    /**
+     * Returns the set of Letter Box letters among 'A' to 'Z', with bit 0 for
+     * 'A'. Independent of the order the letters were given in.
+     */
+    uint32_t alphabetMask() const;
+
 private:
 
-    // A list of "walls" of chars.
-    std::vector<std::vector<char> *> letterWalls;
+    // The walls of chars, stored back to back, lettersPerWall chars each.
+    std::string walls;
+    size_t lettersPerWall;
 
-    // A map from letter to the wall it belongs to.
-    std::unordered_map<char, std::vector<char> *> letterToWall;
+    // The letters contained in the Letter Box, in dense index order.
+    std::string letters;
 
-    // The set of letters contained in the Letter Box.
-    std::unordered_set<char> letters;
+    // Tables from (unsigned) char to the wall it belongs to and to its dense
+    // index, kNone for chars not in the Letter Box.
+    std::array<uint8_t, 256> letterToWall;
+    std::array<uint8_t, 256> letterToIndex;
+
+    // The letters 'A' to 'Z' contained in the Letter Box.
+    uint32_t alphabet;
 
 public:  /* public, but not necessary for most users */
 
     static const size_t kNumWalls;
     static const size_t kMinWordLength;
-
-    ~LetterBox();
+    static const size_t kMaxLetters;
+    static const uint8_t kNone;
 };
 
 #endif
@@ -17,22 +17,116 @@
  * folder, or adding a dictionary of your own and specifying the dictionary
  * you would like to use.
  *
- * This is a multithreaded implementation, where starting from each letter is
- * handled by it's own thread.
+ * A text dictionary can be compiled into a binary index, which is memory
+ * mapped and filtered without parsing:
+ *
+ *     ./letterboxedsolver build-index dictionary.txt dictionary.idx
+ *
+ * The default dictionary is "dictionary.idx" when it exists (the Makefile
+ * builds it), falling back to "dictionary.txt".
+ *
+ * To solve many puzzles without reloading the dictionary each time, run
+ *
+ *     ./letterboxedsolver serve [dictionary [cache directory]]
+ *
+ * and write one "<letters> <n>" request per line to its standard input. A
+ * request may end in a query: "count" to only count the solutions, "exists"
+ * to stop at the first one, "first <k>" to stop after k of them, or
+ * "best <k>" for the k solutions of at most n words with the fewest letters.
+ * Results are cached, in the cache directory too if one is given, so asking
+ * for the same puzzle again (with its walls in any order) is near instant.
+ * A request may also end in "timeout <ms>" or "budget <classes>" to bound
+ * its search, and gets the solutions found by then.
+ *
+ * The program is interactive when run without arguments. For scripting, the
+ * dictionary, letters, number of words and output file can be given as flags,
+ * and --batch solves every "<letters> <n>" line of a file against a single
+ * loaded dictionary, reporting the time taken by each puzzle. Run with --help
+ * for the list of flags. --timeout and --budget stop a search early, keeping
+ * the solutions found so far, and so does Ctrl-C while solving one puzzle.
+ * To split a search too big for one machine, run it with --shard i/N on N
+ * machines, for i from 0 to N - 1, and combine what they find with
+ *
+ *     ./letterboxedsolver merge solutions.txt shard0.txt shard1.txt ...
+ *     ./letterboxedsolver merge --count shard0.count shard1.count ...
+ *
+ * The solutions of a search come out in the order the threads find them.
+ * --sort writes them in alphabetical order instead, and --dedupe classes or
+ * --dedupe sets keeps one solution per path of word classes or per set of
+ * words; both sort on disk once they no longer fit in --sort-memory.
+ *
+ * With --checkpoint, a search of every solution (or a count) of one puzzle
+ * can be stopped, or killed, and later resumed with --resume:
+ *
+ *     ./letterboxedsolver -l ... -n 4 -o out.txt --checkpoint out.ckpt
+ *     ./letterboxedsolver -l ... -n 4 -o out.txt --checkpoint out.ckpt --resume
+ *
+ * This is a multithreaded implementation. The search is split into a task per
+ * first word (and per first two words for longer solutions), which are run by
+ * a work-stealing pool of one thread per core, or as many as --threads says.
  *
  * !!! Important: each letter can only appear *once* in a letter box puzzle
  *                (this is an assumption this program relies on).
  */
 
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
 #include <fstream>
-#include <thread>
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <vector>
+#include "checkpoint.h"
+#include "dictionaryindex.h"
 #include "letterbox.h"
+#include "maskindex.h"
+#include "puzzlecache.h"
+#include "search.h"
+#include "searchlimits.h"
+#include "searchstats.h"
+#include "solutionformatter.h"
+#include "solutionset.h"
+#include "solutionsorter.h"
+#include "solutionstream.h"
+#include "taskpool.h"
 #include "word.h"
-
-using WordTable = std::unordered_map<char, std::unordered_set<Word> >;
-using Solution = std::vector<std::string>;
+#include "wordgraph.h"
+#include <getopt.h>
+#include <unistd.h>
 
 static const std::string DEFAULT_DICT = "dictionary.txt";
+static const std::string DEFAULT_INDEX = "dictionary.idx";
+
+using Clock = std::chrono::steady_clock;
+using Millis = std::chrono::duration<double, std::milli>;
+
+/* The settings given on the command line. */
+struct Options {
+    std::string dictionary;
+    std::string letters;
+    int nWords = 0;
+    std::string output;
+    std::string batch;
+    size_t nThreads = 0;
+    SolutionFormatter::Format format = SolutionFormatter::kPlain;
+    SearchOptions search;
+    bool stats = false;      // print search statistics to stderr
+    std::string statsJson;   // and write them to this file as JSON
+    long long timeout = 0;   // milliseconds per puzzle, 0 for none
+    uint64_t budget = 0;     // word classes per puzzle, 0 for none
+    bool progress = false;   // print the progress of searches to stderr
+    std::string checkpoint;  // keep how far the search has got in this file
+    bool resume = false;     // and carry on from it
+    bool sort = false;       // write solutions in canonical order
+    SolutionSorter::Dedupe dedupe = SolutionSorter::kNone;
+    size_t sortMemory = SolutionSorter::kDefaultMemory;  // bytes
+};
+
+/* The limits of the search Ctrl-C cancels, if one is running. */
+static SearchLimits *interruptible = nullptr;
 
 /* For resetting the input stream */
 static inline void reset(std::istream& in) {
@@ -45,8 +139,8 @@ static inline void reset(std::istream& in) {
  * -----------------------------------
  * Gets a valid dictionary filename from the user.
  *
- * Uses the default dictionary filename if user input is empty, and reprompts
- * if file does not exist.
+ * Uses the default dictionary filename if user input is empty (preferring the
+ * binary index if it exists), and reprompts if file does not exist.
  *
  * @returns the filename of the chosen dictionary.
  */
@@ -72,57 +166,164 @@ std::string getLettersFromUser();
 unsigned int getNumWordsFromUser(const LetterBox &letterBox);
 
 /**
- * Function: buildFilteredWordList
- * -------------------------------
- * Filters words from a dictionary and populates a table with words grouped by
- * starting character.
+ * Function: runInteractive
+ * ------------------------
+ * Prompts the user for a dictionary, letters and number of words, solves the
+ * puzzle, and offers to save the solutions.
  *
- * @param dictFilename the filename of the dictionary to use.
- * @param letterBox the LetterBox puzzle object.
- * @param wordsStartingWith the map from starting character to set of words.
+ * @returns the exit status of the program.
  */
-void buildFilteredWordList(const std::string &dictFilename,
-                           const LetterBox &letterBox,
-                           WordTable &wordsStartingWith);
+int runInteractive();
 
 /**
- * Function: generateSolutions
- * ---------------------------
- * Wrapper function to generate all solutions of a fixed number of words.
+ * Function: parseOptions
+ * ----------------------
+ * Parses the command line flags.
  *
- * @param letterBox the LetterBox puzzle object.
- * @param nWords the number of words per solution.
- * @param wordsStartingWith the map from starting characters to sets of words.
- * @param solutions a vector of solutions to be populated.
+ * @param argc the number of arguments.
+ * @param argv the arguments.
+ * @param options the options to be populated.
+ * @returns true if the flags are valid, false otherwise.
  */
-void generateSolutions(const LetterBox &letterBox, unsigned int nWords,
-                       const WordTable &wordsStartingWith,
-                       std::vector<Solution>& solutions);
+bool parseOptions(int argc, char *argv[], Options &options);
 
 /**
- * Function: generateSolutionsRec
- * ------------------------------
- * Generates solutions to a letterBox puzzle with a given number of words
- * remaining, a given last character typed, a given set of characters
- * remaining, and a given list of already chosen words.
+ * Function: printUsage
+ * --------------------
+ * Prints the command line usage of the program.
  *
- * @param letterBox the LetterBox puzzle object.
- * @param nWords the number of words left in a possible solution.
- * @param last the last character typed that our next word must start with.
- * @param remaining the set of characters we haven't used yet.
- * @param result the solution being built up.
- * @param solutions the vector of all solutions found so far.
- * @param solutionsLock a lock acquired before adding to solutions.
- * @param wordsStartingWith the map from starting characters to sets of words.
+ * @param program the name the program was run as.
+ */
+void printUsage(const std::string &program);
+
+/**
+ * Function: setLimits
+ * -------------------
+ * Sets the limits the command line asks for on the search of a puzzle, and
+ * has them print its progress to stderr if asked to.
+ *
+ * @param options the command line options.
+ * @param limits the limits to set.
+ */
+void setLimits(const Options &options, SearchLimits &limits);
+
+/**
+ * Function: cancelSearch
+ * ----------------------
+ * The handler of SIGINT while a puzzle is being solved: cancels its search,
+ * so that the solutions found so far are written, and lets a second Ctrl-C
+ * end the program as usual.
+ *
+ * @param signal the signal received.
+ */
+extern "C" void cancelSearch(int signal);
+
+/**
+ * Function: runSingle
+ * -------------------
+ * Solves the puzzle given by the options, writing solutions to the output
+ * file, or to standard output if there is none. If the search is stopped
+ * early, by a limit or by Ctrl-C, the solutions found until then are written
+ * and the exit status is 3.
+ *
+ * When sorting, the solutions are passed to a SolutionSorter as they are
+ * found and only written once the search is done.
+ *
+ * With a checkpoint file, the output is first truncated to what the
+ * checkpoint says it held when resuming, and the checkpoint is removed once
+ * the search has run to the end.
+ *
+ * @param dictionary the loaded dictionary (or index) to use.
+ * @param options the command line options.
+ * @returns the exit status of the program.
+ */
+int runSingle(const DictionaryIndex &dictionary, const Options &options);
+
+/**
+ * Function: runBatch
+ * ------------------
+ * Solves every puzzle of the batch file back to back and reports the time
+ * spent filtering and solving each one, followed by the total throughput.
+ * Blank lines and lines starting with '#' are skipped.
+ *
+ * The dictionary is put in a MaskIndex once for the whole batch, so each
+ * puzzle only looks at the words made of its own letters.
+ *
+ * Solutions are streamed to the output file, if any, in the same format as
+ * serve uses, in which case the solve time includes writing them. The limits
+ * of the command line apply to each puzzle on its own, and a puzzle they
+ * stop is reported as such.
+ *
+ * @param dictionary the loaded dictionary (or index) to use.
+ * @param options the command line options.
+ * @returns the exit status of the program.
+ */
+int runBatch(const DictionaryIndex &dictionary, const Options &options);
+
+/**
+ * Function: serve
+ * ---------------
+ * Answers puzzle requests read from a stream until it ends, keeping the
+ * dictionary loaded in between.
+ *
+ * Each request is a line "<letters> <n> [query]". The response is every
+ * solution on its own line, streamed while the search runs (or the number of
+ * solutions for a count query), followed by an empty line, or a single line
+ * starting with "error:" for a malformed request. A request whose timeout or
+ * budget stopped its search gets the solutions found until then, followed
+ * by a line "stopped: deadline" or "stopped: budget", and the result is not
+ * cached.
+ *
+ * Requests go through a PuzzleCache, so a request answered before, for the
+ * same walls in any order, is answered without solving it again.
+ *
+ * @param cache the cache of the dictionary to use.
+ * @param pool the pool puzzles are solved on.
+ * @param in the stream requests are read from.
+ * @param out the stream responses are written to.
  */
-void generateSolutionsRec(const LetterBox &letterBox,
-                          unsigned int nWords,
-                          char last,
-                          std::unordered_set<char> &remaining,
-                          Solution &result,
-                          std::vector<Solution> &solutions,
-                          std::mutex &solutionsLock,
-                          const WordTable &wordsStartingWith);
+void serve(PuzzleCache &cache, TaskPool &pool, std::istream &in,
+           std::ostream &out);
+
+/**
+ * Function: recordPuzzle
+ * ----------------------
+ * Adds the phases of solving a puzzle to the statistics of a run.
+ *
+ * @param stats the statistics to add to.
+ * @param wordsStartingWith the filtered words of the puzzle.
+ * @param start when the puzzle started being filtered.
+ * @param filtered when the filtered words were ready.
+ * @param built when the WordGraph of the words was ready.
+ * @param solved when the search was done and its solutions written.
+ * @param stream the stream the solutions were written to, if any.
+ */
+void recordPuzzle(SearchStats &stats, const WordTable &wordsStartingWith,
+                  Clock::time_point start, Clock::time_point filtered,
+                  Clock::time_point built, Clock::time_point solved,
+                  const SolutionStream *stream);
+
+/**
+ * Function: reportStats
+ * ---------------------
+ * Prints a summary of the statistics of a run to stderr, and writes them as
+ * JSON too if asked to.
+ *
+ * @param stats the statistics of the run.
+ * @param options the settings given on the command line.
+ * @returns false if the JSON file could not be written.
+ */
+bool reportStats(const SearchStats &stats, const Options &options);
+
+/**
+ * Function: writeSolutions
+ * ------------------------
+ * Writes solutions to a stream, one per line.
+ *
+ * @param out the output stream.
+ * @param solutions the solutions to the LetterBox puzzle.
+ */
+void writeSolutions(std::ostream &out, const SolutionSet &solutions);
 
 /**
  * Function: writeSolutionsToFile
@@ -133,7 +334,20 @@ void generateSolutionsRec(const LetterBox &letterBox,
  * @param solutions the solutions to the LetterBox puzzle.
  */
 void writeSolutionsToFile(const std::string &filename,
-                          const std::vector<Solution> &solutions);
+                          const SolutionSet &solutions);
+
+/**
+ * Function: mergeShards
+ * ---------------------
+ * The merge command: concatenates the outputs of the shards of a search into
+ * one file, or with --count, adds up the counts they printed, each read from
+ * a file of its own, and prints the total.
+ *
+ * @param argc the number of arguments, including "merge".
+ * @param argv the arguments.
+ * @returns the exit status of the program.
+ */
+int mergeShards(int argc, char *argv[]);
 
 /**
  * Function: fileExists
@@ -145,14 +359,80 @@ void writeSolutionsToFile(const std::string &filename,
  */
 bool fileExists(const std::string &filename);
 
-int main() {
+int main(int argc, char *argv[]) {
+    if (argc > 1 && std::string(argv[1]) == "build-index") {
+        if (argc != 4) {
+            std::cerr << "Usage: " << argv[0]
+                      << " build-index <dictionary> <index>" << std::endl;
+            return 1;
+        }
+
+        if (!DictionaryIndex::build(argv[2], argv[3])) {
+            std::cerr << "Could not build index \"" << argv[3] << "\" from \""
+                      << argv[2] << "\"." << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    if (argc > 1 && std::string(argv[1]) == "merge") {
+        return mergeShards(argc, argv);
+    }
+
+    if (argc > 1 && std::string(argv[1]) == "serve") {
+        std::string dictionaryFilename = argc > 2 ? argv[2] :
+            fileExists(DEFAULT_INDEX) ? DEFAULT_INDEX : DEFAULT_DICT;
+
+        DictionaryIndex dictionary(dictionaryFilename);
+        if (!dictionary.isOpen()) {
+            std::cerr << "Could not load dictionary \"" << dictionaryFilename
+                      << "\"." << std::endl;
+            return 1;
+        }
+
+        PuzzleCache cache(dictionary, PuzzleCache::kDefaultCapacity,
+                          argc > 3 ? argv[3] : "");
+        TaskPool pool;
+        serve(cache, pool, std::cin, std::cout);
+        return 0;
+    }
+
+    if (argc == 1) return runInteractive();
+
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    SearchStats stats;
+    if (options.stats) options.search.stats = &stats;
+
+    auto start = Clock::now();
+    DictionaryIndex dictionary(options.dictionary);
+    if (!dictionary.isOpen()) {
+        std::cerr << "Could not load dictionary \"" << options.dictionary
+                  << "\"." << std::endl;
+        return 1;
+    }
+    stats.addTime(SearchStats::kLoad, Clock::now() - start);
+
+    int status = options.batch.empty() ? runSingle(dictionary, options)
+                                       : runBatch(dictionary, options);
+    if (options.stats && !reportStats(stats, options)) return 1;
+    return status;
+}
+
+int runInteractive() {
     std::string dictionaryFilename = getDictionaryNameFromUser();
+    DictionaryIndex dictionary(dictionaryFilename);
 
     std::string letters = getLettersFromUser();
     LetterBox letterBox(letters);
 
     WordTable wordsStartingWith;
-    buildFilteredWordList(dictionaryFilename, letterBox, wordsStartingWith);
+    buildFilteredWordList(dictionary, letterBox, wordsStartingWith);
+    WordGraph graph(letterBox, wordsStartingWith);
 
     unsigned int nWords = getNumWordsFromUser(letterBox);
 
@@ -160,8 +440,9 @@ int main() {
                  "minutes for n > 2."
               << std::endl;
 
-    std::vector<Solution> solutions;
-    generateSolutions(letterBox, nWords, wordsStartingWith, solutions);
+    SolutionSet solutions;
+    TaskPool pool;
+    generateSolutions(graph, nWords, SearchOptions(), solutions, pool);
 
     std::cout << solutions.size() << " solution(s) found! Would you like to "
                                      "save them to a file? (y/n): ";
@@ -182,7 +463,7 @@ int main() {
 
 std::string getDictionaryNameFromUser() {
     std::cout << "Enter the filename of the dictionary you want to use "
-                 "(hit enter for \"dictionary.txt\"): ";
+                 "(hit enter for the default dictionary): ";
 
     std::string dictionaryFilename;
     std::getline(std::cin, dictionaryFilename);
@@ -194,7 +475,8 @@ std::string getDictionaryNameFromUser() {
         std::getline(std::cin, dictionaryFilename);
     }
 
-    return dictionaryFilename != "" ? dictionaryFilename : DEFAULT_DICT;
+    if (dictionaryFilename != "") return dictionaryFilename;
+    return fileExists(DEFAULT_INDEX) ? DEFAULT_INDEX : DEFAULT_DICT;
 }
 
 std::string getLettersFromUser() {
@@ -204,9 +486,9 @@ std::string getLettersFromUser() {
     std::string input;
     std::getline(std::cin, input);
 
-    while (input.length() % LetterBox::kNumWalls != 0) {
+    while (!isValidLetters(input)) {
         std::cout << "Please enter a multiple of " << LetterBox::kNumWalls
-                  << " letters:";
+                  << " letters (at most " << LetterBox::kMaxLetters << "):";
 
         std::getline(std::cin, input);
     }
@@ -220,7 +502,7 @@ std::string getLettersFromUser() {
 
 unsigned int getNumWordsFromUser(const LetterBox &letterBox) {
     unsigned int minWords = 1;
-    unsigned int maxWords = letterBox.numLetters() / LetterBox::kMinWordLength;
+    unsigned int maxWords = maxNumWords(letterBox);
 
     std::cout << "Please enter the number of words you want in your solution: ";
 
@@ -237,75 +519,604 @@ unsigned int getNumWordsFromUser(const LetterBox &letterBox) {
     return n;
 }
 
-void generateSolutions(const LetterBox &letterBox, unsigned int nWords,
-                       const WordTable &wordsStartingWith,
-                       std::vector<Solution>& solutions) {
-    std::mutex solutionsLock;
-    std::vector<std::thread> threads;
-    for (char ch : letterBox.getLetters()) {
-        threads.push_back(std::thread([&](char ch) {
-            std::unordered_set<char> remaining = letterBox.getLetters();
-            Solution result(nWords);
 
-            generateSolutionsRec(letterBox, nWords, ch, remaining, result,
-                                 solutions, solutionsLock, wordsStartingWith);
-        }, ch));
+bool parseOptions(int argc, char *argv[], Options &options) {
+    static const option longOptions[] = {
+        {"dictionary", required_argument, nullptr, 'd'},
+        {"letters", required_argument, nullptr, 'l'},
+        {"words", required_argument, nullptr, 'n'},
+        {"output", required_argument, nullptr, 'o'},
+        {"batch", required_argument, nullptr, 'b'},
+        {"threads", required_argument, nullptr, 't'},
+        {"format", required_argument, nullptr, 'f'},
+        {"engine", required_argument, nullptr, 'e'},
+        {"query", required_argument, nullptr, 'q'},
+        {"first", required_argument, nullptr, 'k'},
+        {"best", required_argument, nullptr, 'r'},
+        {"incremental", no_argument, nullptr, 'i'},
+        {"stats", no_argument, nullptr, 's'},
+        {"stats-json", required_argument, nullptr, 'S'},
+        {"timeout", required_argument, nullptr, 'T'},
+        {"budget", required_argument, nullptr, 'B'},
+        {"progress", no_argument, nullptr, 'P'},
+        {"checkpoint", required_argument, nullptr, 'C'},
+        {"resume", no_argument, nullptr, 'R'},
+        {"shard", required_argument, nullptr, 'H'},
+        {"sort", no_argument, nullptr, 'O'},
+        {"dedupe", required_argument, nullptr, 'U'},
+        {"sort-memory", required_argument, nullptr, 'M'},
+        {"help", no_argument, nullptr, 'h'},
+        {nullptr, 0, nullptr, 0}
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "d:l:n:o:b:t:f:e:q:k:r:ish",
+                              longOptions, nullptr)) != -1) {
+        switch (opt) {
+            case 'd': options.dictionary = optarg; break;
+            case 'l': options.letters = optarg; break;
+            case 'n': options.nWords = atoi(optarg); break;
+            case 'o': options.output = optarg; break;
+            case 'b': options.batch = optarg; break;
+            case 't':
+                if (atoi(optarg) < 0) return false;
+                options.nThreads = atoi(optarg);
+                break;
+            case 'f':
+                if (!SolutionFormatter::parseFormat(optarg, options.format)) {
+                    return false;
+                }
+                break;
+            case 'e':
+                if (std::string(optarg) == "dfs") {
+                    options.search.engine = SearchOptions::kDfs;
+                } else if (std::string(optarg) == "join") {
+                    options.search.engine = SearchOptions::kJoin;
+                } else if (std::string(optarg) == "dp") {
+                    options.search.engine = SearchOptions::kDp;
+                } else {
+                    return false;
+                }
+                break;
+            case 'q':
+                if (!parseQuery(optarg, options.search) ||
+                    options.search.query == SearchOptions::kFirst ||
+                    options.search.query == SearchOptions::kBest) {
+                    return false;
+                }
+                break;
+            case 'k':
+                if (atoll(optarg) < 1) return false;
+                options.search.query = SearchOptions::kFirst;
+                options.search.limit = atoll(optarg);
+                break;
+            case 'r':
+                if (atoll(optarg) < 1) return false;
+                options.search.query = SearchOptions::kBest;
+                options.search.limit = atoll(optarg);
+                break;
+            case 'i': options.search.incremental = true; break;
+            case 's': options.stats = true; break;
+            case 'S':
+                options.stats = true;
+                options.statsJson = optarg;
+                break;
+            case 'T':
+                if (atoll(optarg) < 1) return false;
+                options.timeout = atoll(optarg);
+                break;
+            case 'B':
+                if (atoll(optarg) < 1) return false;
+                options.budget = atoll(optarg);
+                break;
+            case 'P': options.progress = true; break;
+            case 'C': options.checkpoint = optarg; break;
+            case 'R': options.resume = true; break;
+            case 'O': options.sort = true; break;
+            case 'U':
+                if (!SolutionSorter::parseDedupe(optarg, options.dedupe)) {
+                    return false;
+                }
+                options.sort = true;
+                break;
+            case 'M':
+                if (atoll(optarg) < 1) return false;
+                options.sortMemory = size_t(atoll(optarg)) << 20;
+                break;
+            case 'H': {
+                char slash = 0;
+                std::istringstream shard(optarg);
+                if (!(shard >> options.search.shard >> slash >>
+                      options.search.nShards) || slash != '/' ||
+                    !shard.eof() || options.search.nShards == 0 ||
+                    options.search.shard >= options.search.nShards) {
+                    return false;
+                }
+                break;
+            }
+            default: return false;
+        }
+    }
+
+    if (optind != argc) return false;
+    if (options.batch.empty() && options.letters.empty()) return false;
+    if (options.resume && options.checkpoint.empty()) return false;
+
+    const SearchOptions &search = options.search;
+    if (search.nShards > 1 &&
+        (search.incremental || search.query == SearchOptions::kBest)) {
+        return false;
     }
 
-    for (std::thread& t : threads) t.join();
+    // Sorting holds the solutions of one puzzle of a single number of words
+    // until the search is done.
+    if (options.sort &&
+        (!options.batch.empty() || !options.checkpoint.empty() ||
+         search.incremental || search.query == SearchOptions::kCount ||
+         search.query == SearchOptions::kBest)) {
+        return false;
+    }
+
+    // Only an exhaustive search of one puzzle, and one whose output can be
+    // truncated, can be checkpointed.
+    if (!options.checkpoint.empty() &&
+        (!options.batch.empty() || search.incremental || search.limit != 0 ||
+         search.query == SearchOptions::kExists ||
+         search.query == SearchOptions::kBest ||
+         (search.query != SearchOptions::kCount && options.output.empty()))) {
+        return false;
+    }
+
+    if (options.dictionary.empty()) {
+        options.dictionary = fileExists(DEFAULT_INDEX) ? DEFAULT_INDEX
+                                                       : DEFAULT_DICT;
+    }
+    return true;
 }
 
-void generateSolutionsRec(const LetterBox &letterBox,
-                          unsigned int nWords,
-                          char last,
-                          std::unordered_set<char> &remaining,
-                          Solution &result,
-                          std::vector<Solution> &solutions,
-                          std::mutex &solutionsLock,
-                          const WordTable &wordsStartingWith) {
-    if (nWords == 0) {
-        if (remaining.empty()) {
-            std::lock_guard<std::mutex> lg(solutionsLock);
-            solutions.push_back(result);
+void printUsage(const std::string &program) {
+    std::cerr << "Usage: " << program << "\n"
+              << "       " << program << " [-d dictionary] -l letters -n words"
+                                         " [-o output]\n"
+              << "       " << program << " [-d dictionary] -b batch"
+                                         " [-o output]\n"
+              << "       " << program << " serve [dictionary"
+                                         " [cache directory]]\n"
+              << "       " << program << " build-index <dictionary> <index>\n"
+              << "       " << program << " merge <output> <shard output>...\n"
+              << "       " << program << " merge --count <shard count>...\n"
+              << "\n"
+              << "  -d, --dictionary FILE  dictionary or index to use\n"
+              << "  -l, --letters LETTERS  letters of each wall, in order\n"
+              << "  -n, --words N          number of words per solution\n"
+              << "  -o, --output FILE      write solutions to FILE\n"
+              << "  -b, --batch FILE       solve each \"<letters> <n>\" line"
+                                         " of FILE\n"
+              << "  -t, --threads N        search with N threads"
+                                         " (default: one per core)\n"
+              << "  -f, --format FORMAT    write solutions as plain (default),"
+                                         " csv, json\n"
+              << "                         or binary (word ids as 32-bit"
+                                         " integers)\n"
+              << "  -e, --engine ENGINE    search with join (default), dfs"
+                                         " to try every word\n"
+              << "                         for the last word too, or dp to"
+                                         " skip dead ends\n"
+              << "                         (and count without searching)\n"
+              << "  -q, --query QUERY      all (default), count to only count"
+                                         " solutions, or\n"
+              << "                         exists to stop at the first one"
+                                         " (exit status 2\n"
+              << "                         if there is none)\n"
+              << "  -k, --first K          stop after the first K solutions\n"
+              << "  -r, --best K           find the K solutions with the"
+                                         " fewest words, then\n"
+              << "                         the fewest letters (-n is then the"
+                                         " most words\n"
+              << "                         tried, by default as many as can"
+                                         " be needed)\n"
+              << "  -i, --incremental      also find the solutions of fewer"
+                                         " words, in the same\n"
+              << "                         search (a count is then given per"
+                                         " number of words)\n"
+              << "  -s, --stats            print the time of each phase and"
+                                         " search counts\n"
+              << "                         to stderr\n"
+              << "      --stats-json FILE  write them to FILE as JSON too\n"
+              << "      --timeout MS       stop searching a puzzle after MS"
+                                         " milliseconds,\n"
+              << "                         keeping the solutions found so far"
+                                         " (exit status 3)\n"
+              << "      --budget N         stop searching a puzzle after"
+                                         " visiting N word\n"
+              << "                         classes, likewise\n"
+              << "      --progress         print the progress of each search"
+                                         " to stderr\n"
+              << "                         every second\n"
+              << "      --checkpoint FILE  keep how far the search has got in"
+                                         " FILE, for all\n"
+              << "                         (with -o) and count queries of"
+                                         " one puzzle\n"
+              << "      --resume           carry on from the checkpoint,"
+                                         " appending to the\n"
+              << "                         output\n"
+              << "      --shard I/N        only search slice I of N (from 0),"
+                                         " for all but\n"
+              << "                         best and incremental searches\n"
+              << "      --sort             write solutions in alphabetical"
+                                         " order\n"
+              << "      --dedupe MODE      sort, keeping one solution per"
+                                         " path of word\n"
+              << "                         classes (classes) or per set of"
+                                         " words (sets)\n"
+              << "      --sort-memory MB   sort in MB of memory, then on"
+                                         " disk (default: 256)\n"
+              << "\n"
+              << "With no arguments the program asks for each setting."
+              << std::endl;
+}
+
+int runSingle(const DictionaryIndex &dictionary, const Options &options) {
+    std::string letters;
+    unsigned int nWords;
+    SearchOptions search = options.search;
+    std::string error;
+    int n = options.nWords;
+    if (n == 0 && search.query == SearchOptions::kBest &&
+        isValidLetters(options.letters)) {
+        n = maxNumWords(LetterBox(options.letters));
+    }
+    if (!parsePuzzle(options.letters + " " + std::to_string(n),
+                     letters, nWords, search, error)) {
+        std::cerr << "Invalid puzzle: " << error << "." << std::endl;
+        return 1;
+    }
+
+    auto start = Clock::now();
+    LetterBox letterBox(letters);
+    WordTable wordsStartingWith;
+    buildFilteredWordList(dictionary, letterBox, wordsStartingWith);
+    auto filtered = Clock::now();
+    WordGraph graph(letterBox, wordsStartingWith);
+    auto built = Clock::now();
+
+    bool counting = search.query == SearchOptions::kCount;
+    std::unique_ptr<Checkpoint> checkpoint;
+    uint64_t nFoundBefore = 0;
+    if (!options.checkpoint.empty()) {
+        std::ostringstream key;
+        key << letters << " " << nWords << " " << int(search.query) << " "
+            << int(search.engine) << " " << int(options.format) << " "
+            << search.shard << "/" << search.nShards << " " << std::hex
+            << dictionary.fingerprint();
+        checkpoint.reset(new Checkpoint(options.checkpoint, key.str()));
+        if (options.resume && !checkpoint->load(error)) {
+            std::cerr << "Could not resume: " << error << "." << std::endl;
+            return 1;
+        }
+        nFoundBefore = checkpoint->numFound();
+        search.checkpoint = checkpoint.get();
+    }
+
+    std::fstream file;
+    if (!options.output.empty() && !counting) {
+        if (checkpoint != nullptr && checkpoint->isResumed()) {
+            if (truncate(options.output.c_str(),
+                         checkpoint->outputSize()) != 0) {
+                std::cerr << "Could not truncate \"" << options.output
+                          << "\" to resume." << std::endl;
+                return 1;
+            }
+            file.open(options.output, std::ios::in | std::ios::out |
+                                      std::ios::binary);
+            file.seekp(0, std::ios::end);
+        } else {
+            file.open(options.output, std::ios::out | std::ios::trunc |
+                                      std::ios::binary);
         }
-        return;
     }
+    std::ostream &out = options.output.empty() ? std::cout : file;
 
-    if (wordsStartingWith.count(last) == 0) return;
+    TaskPool pool(options.nThreads);
+    std::unique_ptr<SolutionSorter> sorter;
+    std::unique_ptr<SolutionStream> stream;
+    if (options.sort) {
+        sorter.reset(new SolutionSorter(wordsStartingWith, graph, nWords,
+                                        options.dedupe, options.sortMemory));
+        stream.reset(new SolutionStream([&sorter](const SolutionSet &batch) {
+            sorter->add(batch);
+        }));
+    } else {
+        stream.reset(new SolutionStream(out, options.format));
+    }
+    if (checkpoint != nullptr && !counting) {
+        checkpoint->setOutput([&stream, &file] {
+            stream->flushOutput();
+            file.flush();
+            return uint64_t(file.tellp());
+        });
+    }
+    SearchLimits limits;
+    setLimits(options, limits);
+    search.limits = &limits;
+    std::vector<uint64_t> nFoundByWords;
+    interruptible = &limits;
+    std::signal(SIGINT, cancelSearch);
+    uint64_t nFound = solvePuzzle(graph, nWords, search, pool, stream.get(),
+                                  &nFoundByWords);
+    std::signal(SIGINT, SIG_DFL);
+    interruptible = nullptr;
+    stream->close();
+    if (sorter != nullptr) {
+        SolutionFormatter formatter(out, options.format);
+        nFound = sorter->finish([&formatter](const SolutionSet &batch) {
+            formatter.write(batch);
+        });
+        if (nFound == UINT64_MAX) {
+            std::cerr << "Could not sort the solutions: a temporary file"
+                         " could not be written." << std::endl;
+            return 1;
+        }
+    }
+    if (search.stats != nullptr) {
+        recordPuzzle(*search.stats, wordsStartingWith, start, filtered, built,
+                     Clock::now(), stream.get());
+    }
+    if (checkpoint != nullptr) {
+        nFound += nFoundBefore;
+        if (limits.stopped() && !checkpoint->save()) {
+            std::cerr << "Could not write checkpoint \"" << options.checkpoint
+                      << "\"." << std::endl;
+        } else if (!limits.stopped()) {
+            std::remove(options.checkpoint.c_str());
+        }
+    }
 
-    for (const auto& word : wordsStartingWith.at(last)) {
-        if (nWords == 1 && remaining.size() > word.nUniqueLetters) continue;
+    if (counting && search.incremental) {
+        for (unsigned int n = 1; n <= nWords; n++) {
+            std::cout << n << " " << nFoundByWords[n] << "\n";
+        }
+        std::cout << std::flush;
+    } else if (counting) {
+        std::cout << nFound << std::endl;
+    } else if (!options.output.empty()) {
+        std::cout << nFound << " solution(s) found." << std::endl;
+    }
 
-        auto remainingCopy = remaining;
-        for (char ch : word.content) remainingCopy.erase(ch);
-        result[result.size() - nWords] = word.content;
-        generateSolutionsRec(letterBox, nWords - 1, word[word.size() - 1],
-                             remainingCopy, result, solutions,
-                             solutionsLock, wordsStartingWith);
+    if (limits.stopped()) {
+        std::cerr << "Search stopped early ("
+                  << SearchLimits::outcomeName(limits.outcome()) << ")."
+                  << std::endl;
+        if (checkpoint != nullptr) {
+            std::cerr << "Run again with --resume to carry on." << std::endl;
+        }
+        return 3;
     }
+    return search.query == SearchOptions::kExists && nFound == 0 ? 2 : 0;
 }
 
-void buildFilteredWordList(const std::string &dictFilename,
-    const LetterBox &letterBox,
-    std::unordered_map<char, std::unordered_set<Word> > &wordsStartingWith) {
-    std::ifstream file(dictFilename);
-    std::string word;
-    while (getline(file, word)) {
-        if (!letterBox.canMakeWord(word)) continue;
-        wordsStartingWith[word[0]].insert(Word(word));
+int runBatch(const DictionaryIndex &dictionary, const Options &options) {
+    std::ifstream batch(options.batch);
+    if (!batch) {
+        std::cerr << "Could not open batch file \"" << options.batch << "\"."
+                  << std::endl;
+        return 1;
     }
+
+    std::ofstream out;
+    if (!options.output.empty()) out.open(options.output);
+
+    TaskPool pool(options.nThreads);
+    MaskIndex masks(dictionary);
+    size_t nPuzzles = 0, lineNum = 0;
+    uint64_t nSolutions = 0;
+    Millis total(0);
+    std::string line;
+    while (getline(batch, line)) {
+        lineNum++;
+        if (line.find_first_not_of(" \t\r") == std::string::npos ||
+            line[0] == '#') {
+            continue;
+        }
+
+        std::string letters;
+        unsigned int nWords;
+        SearchOptions search = options.search;
+        std::string error;
+        if (!parsePuzzle(line, letters, nWords, search, error)) {
+            std::cerr << options.batch << ":" << lineNum << ": " << error
+                      << std::endl;
+            continue;
+        }
+
+        auto start = Clock::now();
+        LetterBox letterBox(letters);
+        WordTable wordsStartingWith;
+        buildFilteredWordList(dictionary, masks, letterBox,
+                              wordsStartingWith);
+        auto wordsFiltered = Clock::now();
+        WordGraph graph(letterBox, wordsStartingWith);
+
+        auto filtered = Clock::now();
+        SearchLimits limits;
+        setLimits(options, limits);
+        search.limits = &limits;
+        uint64_t nFound;
+        if (out.is_open()) {
+            SolutionStream stream(out, options.format);
+            nFound = solvePuzzle(graph, nWords, search, pool, &stream);
+            stream.close();
+            if (search.stats != nullptr) {
+                recordPuzzle(*search.stats, wordsStartingWith, start,
+                             wordsFiltered, filtered, Clock::now(), &stream);
+            }
+            if (search.query == SearchOptions::kCount) out << nFound << "\n";
+            if (options.format != SolutionFormatter::kBinary) out << std::endl;
+        } else {
+            nFound = solvePuzzle(graph, nWords, search, pool);
+            if (search.stats != nullptr) {
+                recordPuzzle(*search.stats, wordsStartingWith, start,
+                             wordsFiltered, filtered, Clock::now(), nullptr);
+            }
+        }
+        auto solved = Clock::now();
+
+        std::cout << letters << " " << nWords << ": " << nFound
+                  << " solution(s), filter " << Millis(filtered - start).count()
+                  << " ms, solve " << Millis(solved - filtered).count()
+                  << " ms";
+        if (limits.stopped()) {
+            std::cout << ", stopped ("
+                      << SearchLimits::outcomeName(limits.outcome()) << ")";
+        }
+        std::cout << std::endl;
+
+        nPuzzles++;
+        nSolutions += nFound;
+        total += solved - start;
+    }
+
+    double seconds = total.count() / 1000;
+    std::cout << nPuzzles << " puzzle(s), " << nSolutions << " solution(s) in "
+              << seconds << " s";
+    if (seconds > 0) {
+        std::cout << " (" << nPuzzles / seconds << " puzzles/s, "
+                  << nSolutions / seconds << " solutions/s)";
+    }
+    std::cout << std::endl;
+    return 0;
+}
+
+void serve(PuzzleCache &cache, TaskPool &pool, std::istream &in,
+           std::ostream &out) {
+    std::string line;
+    while (getline(in, line)) {
+        if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+
+        std::string letters;
+        unsigned int nWords;
+        SearchOptions search;
+        SearchLimits limits;
+        search.limits = &limits;
+        std::string error;
+        if (!parsePuzzle(line, letters, nWords, search, error, &limits)) {
+            out << "error: " << error << std::endl;
+            continue;
+        }
+
+        SolutionFormatter formatter(out);
+        uint64_t nFound = cache.solve(letters, nWords, search, pool,
+                                      [&formatter](const SolutionSet &batch) {
+                                          formatter.write(batch);
+                                      });
+        formatter.flush();
+        if (search.query == SearchOptions::kCount) out << nFound << "\n";
+        if (limits.stopped()) {
+            out << "stopped: " << SearchLimits::outcomeName(limits.outcome())
+                << "\n";
+        }
+        out << std::endl;
+    }
+}
+
+void setLimits(const Options &options, SearchLimits &limits) {
+    if (options.timeout != 0) {
+        limits.setTimeout(std::chrono::milliseconds(options.timeout));
+    }
+    if (options.budget != 0) limits.setBudget(options.budget);
+    if (!options.progress) return;
+
+    limits.onProgress([](const SearchLimits::Progress &progress) {
+        std::cerr << "progress: " << progress.nSubtreesDone << "/"
+                  << progress.nSubtrees << " first words, "
+                  << progress.nFound << " solution(s), "
+                  << progress.nVisited << " word classes" << std::endl;
+    }, std::chrono::seconds(1));
+}
+
+void cancelSearch(int signal) {
+    std::signal(signal, SIG_DFL);
+    if (interruptible != nullptr) interruptible->cancel();
+}
+
+void recordPuzzle(SearchStats &stats, const WordTable &wordsStartingWith,
+                  Clock::time_point start, Clock::time_point filtered,
+                  Clock::time_point built, Clock::time_point solved,
+                  const SolutionStream *stream) {
+    stats.countWords(wordsStartingWith);
+    stats.addTime(SearchStats::kFilter, filtered - start);
+    stats.addTime(SearchStats::kGraph, built - filtered);
+    stats.addTime(SearchStats::kSolve, solved - built);
+    if (stream != nullptr) {
+        stats.addTime(SearchStats::kWrite, stream->writeTime());
+        stats.addLockWait(stream->waitTime());
+    }
+}
+
+bool reportStats(const SearchStats &stats, const Options &options) {
+    stats.printSummary(std::cerr);
+    if (options.statsJson.empty()) return true;
+
+    std::ofstream out(options.statsJson);
+    stats.writeJson(out);
+    if (!out) {
+        std::cerr << "Could not write statistics to \"" << options.statsJson
+                  << "\"." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void writeSolutions(std::ostream &out, const SolutionSet &solutions) {
+    SolutionFormatter formatter(out);
+    formatter.write(solutions);
 }
 
 void writeSolutionsToFile(const std::string &filename,
-                          const std::vector<Solution> &solutions) {
+                          const SolutionSet &solutions) {
     std::ofstream out(filename);
+    writeSolutions(out, solutions);
+}
+
+int mergeShards(int argc, char *argv[]) {
+    bool counts = argc > 2 && std::string(argv[2]) == "--count";
+    if (argc < 4) {
+        std::cerr << "Usage: " << argv[0]
+                  << " merge <output> <shard output>...\n"
+                  << "       " << argv[0]
+                  << " merge --count <shard count>..." << std::endl;
+        return 1;
+    }
 
-    for (const auto &solution : solutions) {
-        for (const auto &word : solution) {
-            out << word << " ";
+    std::ofstream out;
+    if (!counts) {
+        out.open(argv[2], std::ios::out | std::ios::trunc | std::ios::binary);
+        if (!out) {
+            std::cerr << "Could not write \"" << argv[2] << "\"." << std::endl;
+            return 1;
+        }
+    }
+
+    uint64_t total = 0;
+    for (int i = 3; i < argc; i++) {
+        std::ifstream in(argv[i], std::ios::in | std::ios::binary);
+        unsigned long long count;
+        if (!in || (counts && !(in >> count))) {
+            std::cerr << "Could not read shard \"" << argv[i] << "\"."
+                      << std::endl;
+            return 1;
+        }
+        if (counts) {
+            total += count;
+        } else if (in.peek() != std::ifstream::traits_type::eof() &&
+                   !(out << in.rdbuf())) {
+            std::cerr << "Could not write \"" << argv[2] << "\"." << std::endl;
+            return 1;
         }
-        out << std::endl;
     }
+
+    if (counts) std::cout << total << std::endl;
+    return 0;
 }
 
 bool fileExists(const std::string &filename) {
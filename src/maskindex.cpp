@@ -0,0 +1,76 @@
+/*
+ * File: maskindex.cpp
+ * Author: Jeremy Ephron
+ * ---------------------
+ * The implementation of the MaskIndex class.
+ */
+
+#include "maskindex.h"
+#include <algorithm>
+#include <cstring>
+#include "letterbox.h"
+
+using Entry = DictionaryIndex::Entry;
+
+const size_t MaskIndex::kTextLength = 16;
+const size_t MaskIndex::kTextStride = 24;
+const size_t MaskIndex::kLowLetters = 13;
+
+/* Returns whether a word can be written in some box. */
+static bool canBeWritten(const char *text, size_t length) {
+    if (length < LetterBox::kMinWordLength) return false;
+    for (size_t i = 1; i < length; i++) {
+        if (text[i] == text[i - 1]) return false;
+    }
+    return true;
+}
+
+MaskIndex::MaskIndex(const DictionaryIndex &dictionary) {
+    if (!dictionary.isOpen()) return;
+    const uint32_t *alphabetMasks = dictionary.alphabetMasks();
+
+    // Sorts the words by mask, keeping index order within a mask, then lays
+    // the buckets and groups out from the runs of equal masks.
+    std::vector<std::pair<uint32_t, const Entry *> > kept;
+    for (char first = 'A'; first <= 'Z'; first++) {
+        for (const Entry *entry = dictionary.begin(first);
+             entry != dictionary.end(first); entry++) {
+            if (canBeWritten(dictionary.text(*entry), entry->length)) {
+                kept.emplace_back(alphabetMasks[dictionary.id(*entry)], entry);
+            }
+        }
+    }
+    std::stable_sort(kept.begin(), kept.end(),
+                     [](const std::pair<uint32_t, const Entry *> &a,
+                        const std::pair<uint32_t, const Entry *> &b) {
+                         return a.first < b.first;
+                     });
+
+    size_t nGroups = size_t(1) << (26 - kLowLetters);
+    groupOffsets.assign(nGroups + 1, 0);
+    entries.resize(kept.size());
+    texts.assign(kept.size() * kTextStride, 0);
+    lengths.resize(kept.size());
+    for (uint32_t i = 0; i < kept.size(); i++) {
+        uint32_t mask = kept[i].first;
+        if (masks.empty() || masks.back() != mask) {
+            masks.push_back(mask);
+            buckets.push_back({i, i});
+            groupOffsets[(mask >> kLowLetters) + 1]++;
+        }
+        buckets.back().end++;
+
+        const Entry *entry = kept[i].second;
+        entries[i] = entry;
+        lengths[i] = entry->length;
+        memcpy(texts.data() + size_t(i) * kTextStride, dictionary.text(*entry),
+               std::min<size_t>(entry->length, kTextLength));
+    }
+    for (size_t high = 0; high < nGroups; high++) {
+        groupOffsets[high + 1] += groupOffsets[high];
+    }
+}
+
+size_t MaskIndex::numMasks() const {
+    return this->masks.size();
+}
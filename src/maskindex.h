@@ -0,0 +1,117 @@
+/*
+ * File: maskindex.h
+ * Author: Jeremy Ephron
+ * ---------------------
+ * The interface for the MaskIndex class, which finds the words of a
+ * DictionaryIndex that only use letters of a given alphabet without looking
+ * at the others.
+ *
+ * The entries of the dictionary are bucketed by their alphabet mask once,
+ * when the index is built, and the buckets sorted by mask, which groups them
+ * by their letters after the first kLowLetters of the alphabet. A query
+ * enumerates the subsets of its own letters of that part, and checks the
+ * masks of the group of each one, so it never looks at a word with a letter
+ * from there that is not in the box.
+ *
+ * The first kTextLength letters of every word are copied next to those of
+ * the other words of its bucket, in the order of the buckets, so that the
+ * words a query finds are checked reading memory front to back rather than a
+ * line of the dictionary per word. Words that no box can hold, those shorter
+ * than LetterBox::kMinWordLength and those with a letter twice in a row
+ * (which is always on its own wall), are left out of the index altogether.
+ *
+ * This pays off when many boxes are filtered against one dictionary, as a
+ * batch or a server does; a single puzzle is better off scanning the
+ * dictionary with a WordFilter than building the index.
+ */
+
+#ifndef Mask_Index
+#define Mask_Index
+
+#include <cstdint>
+#include <vector>
+#include "dictionaryindex.h"
+
+class MaskIndex {
+public:  /* Interface */
+
+    /** The words of the dictionary that share an alphabet mask. */
+    struct Bucket {
+        uint32_t begin;     // range of words of the index holding them
+        uint32_t end;
+    };
+
+    /** Buckets the entries of a dictionary, which must outlive the index. */
+    MaskIndex(const DictionaryIndex &dictionary);
+
+    /**
+     * Calls visit(bucket) for every bucket whose words only use letters of
+     * alphabet (a mask with bit 0 for 'A').
+     */
+    template <typename Visitor>
+    void forEachSubset(uint32_t alphabet, Visitor visit) const;
+
+    /** Returns the dictionary entry of word i of the index. */
+    const DictionaryIndex::Entry *entry(uint32_t i) const {
+        return entries[i];
+    }
+
+    /** Returns the number of letters of word i of the index. */
+    size_t length(uint32_t i) const {
+        return lengths[i];
+    }
+
+    /**
+     * Returns the first kTextLength letters of word i of the index, followed
+     * by zeros up to kTextStride bytes.
+     */
+    const char *text(uint32_t i) const {
+        return texts.data() + size_t(i) * kTextStride;
+    }
+
+    /** Returns the number of distinct alphabet masks of the dictionary. */
+    size_t numMasks() const;
+
+private:
+
+    std::vector<const DictionaryIndex::Entry *> entries;  // bucket by bucket
+    std::vector<char> texts;        // kTextStride bytes per entry
+    std::vector<uint8_t> lengths;
+    std::vector<uint32_t> masks;    // the mask of each bucket, ascending
+    std::vector<Bucket> buckets;
+
+    // The buckets whose masks have high as their letters after the first
+    // kLowLetters are [groupOffsets[high], groupOffsets[high + 1]).
+    std::vector<uint32_t> groupOffsets;
+
+public:  /* public, but not necessary for most users */
+
+    static const size_t kTextLength;
+    static const size_t kTextStride;
+    static const size_t kLowLetters;
+
+    MaskIndex(const MaskIndex &) = delete;
+    MaskIndex &operator=(const MaskIndex &) = delete;
+};
+
+template <typename Visitor>
+void MaskIndex::forEachSubset(uint32_t alphabet, Visitor visit) const {
+    if (groupOffsets.empty()) return;
+
+    // Walks the subsets of the high letters upwards, so that the buckets are
+    // visited in order.
+    uint32_t low = alphabet & ((uint32_t(1) << kLowLetters) - 1);
+    uint32_t high = alphabet >> kLowLetters;
+    uint32_t subset = 0;
+    do {
+        for (uint32_t i = groupOffsets[subset]; i < groupOffsets[subset + 1];
+             i++) {
+            if ((masks[i] & ~(low | subset << kLowLetters)) == 0) {
+                visit(buckets[i]);
+            }
+        }
+        subset = (subset - high) & high;
+    } while (subset != 0);
+}
+
+#endif
@@ -0,0 +1,271 @@
+/*
+ * File: puzzlecache.cpp
+ * Author: Jeremy Ephron
+ * ---------------------
+ * The implementation of the PuzzleCache class.
+ *
+ * A result file is the magic, the number of solutions found and the number
+ * of batches, then for each batch its number of words and of solutions and
+ * the dictionary ids of their words. It is written to a temporary file and
+ * renamed, so a reader never sees half a result.
+ */
+
+#include "puzzlecache.h"
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <thread>
+#include <unistd.h>
+
+const size_t PuzzleCache::kDefaultCapacity = 64;
+const size_t PuzzleCache::kMaxSolutions = 1 << 16;
+const char PuzzleCache::kMagic[8] = {'L', 'B', 'X', 'C', 'A', 'C', 'H', '1'};
+
+/* Returns the name of a query, as given to parseQuery. */
+static const char *queryName(SearchOptions::Query query) {
+    static const char *const kNames[] = {
+        "all", "count", "exists", "first", "best"
+    };
+    return kNames[query];
+}
+
+/* Returns the filtered words of a box, for the member initializer list. */
+static WordTable filterWords(const DictionaryIndex &dictionary,
+                             const MaskIndex &masks,
+                             const LetterBox &letterBox) {
+    WordTable wordsStartingWith;
+    buildFilteredWordList(dictionary, masks, letterBox, wordsStartingWith);
+    return wordsStartingWith;
+}
+
+PuzzleCache::Puzzle::Puzzle(const DictionaryIndex &dictionary,
+                            const MaskIndex &masks,
+                            const std::string &letters)
+    : letterBox(letters),
+      wordsStartingWith(filterWords(dictionary, masks, letterBox)),
+      graph(letterBox, wordsStartingWith) {}
+
+PuzzleCache::PuzzleCache(const DictionaryIndex &dictionary, size_t capacity,
+                         const std::string &directory)
+    : dictionary(dictionary), masks(dictionary), directory(directory),
+      fingerprint(0),
+      puzzles(capacity), results(capacity), hits(0), misses(0) {
+    if (!directory.empty()) fingerprint = dictionary.fingerprint();
+}
+
+std::shared_ptr<const PuzzleCache::Puzzle>
+PuzzleCache::puzzle(const std::string &letters) {
+    std::string canonical = LetterBox(letters).canonicalLetters();
+    {
+        std::lock_guard<std::mutex> lg(lock);
+        std::shared_ptr<const Puzzle> found = puzzles.find(canonical);
+        if (found != nullptr) return found;
+    }
+
+    std::shared_ptr<const Puzzle> filtered =
+        std::make_shared<const Puzzle>(dictionary, masks, canonical);
+    std::lock_guard<std::mutex> lg(lock);
+    puzzles.insert(canonical, filtered);
+    return filtered;
+}
+
+uint64_t PuzzleCache::solve(const std::string &letters, unsigned int nWords,
+                            const SearchOptions &search, TaskPool &pool,
+                            const SolutionStream::Consumer &consumer) {
+    // The canonical box numbers its tasks unlike the box as given, so its
+    // shards are other slices of the solutions: a shard is searched on the
+    // box as given, and not cached.
+    if (search.nShards > 1) {
+        Puzzle given(dictionary, masks, letters);
+        SolutionStream stream(consumer);
+        uint64_t nFound = solvePuzzle(given.graph, nWords, search, pool,
+                                      &stream);
+        stream.close();
+        return nFound;
+    }
+
+    std::string canonical = LetterBox(letters).canonicalLetters();
+    std::string key = resultKey(canonical, nWords, search);
+
+    std::shared_ptr<const Result> result;
+    {
+        std::lock_guard<std::mutex> lg(lock);
+        result = results.find(key);
+    }
+    std::shared_ptr<const Puzzle> words;
+    if (result == nullptr) {
+        words = puzzle(canonical);
+        if (!directory.empty()) result = load(key, words);
+    }
+
+    if (result != nullptr) {
+        {
+            std::lock_guard<std::mutex> lg(lock);
+            hits++;
+            results.insert(key, result);
+        }
+        for (const SolutionSet &batch : result->batches) consumer(batch);
+        return result->nFound;
+    }
+
+    // Keeps a copy of the solutions as they are consumed, unless there are
+    // too many to keep.
+    std::shared_ptr<Result> found = std::make_shared<Result>();
+    found->puzzle = words;
+    size_t nKept = 0;
+    bool fits = true;
+    SolutionStream stream([&](const SolutionSet &batch) {
+        consumer(batch);
+        if (!fits) return;
+
+        nKept += batch.size();
+        if (nKept > kMaxSolutions) {
+            fits = false;
+            found->batches.clear();
+            return;
+        }
+        if (found->batches.empty() ||
+            found->batches.back().nWords != batch.nWords) {
+            found->batches.emplace_back(batch.nWords);
+        }
+        found->batches.back().append(batch);
+    });
+    found->nFound = solvePuzzle(words->graph, nWords, search, pool, &stream);
+    stream.close();
+
+    // A search a limit stopped found only some of the solutions.
+    bool complete = search.limits == nullptr || !search.limits->stopped();
+    {
+        std::lock_guard<std::mutex> lg(lock);
+        misses++;
+        if (fits && complete) results.insert(key, found);
+    }
+    if (fits && complete && !directory.empty()) save(key, *found);
+    return found->nFound;
+}
+
+uint64_t PuzzleCache::numHits() const {
+    std::lock_guard<std::mutex> lg(lock);
+    return this->hits;
+}
+
+uint64_t PuzzleCache::numMisses() const {
+    std::lock_guard<std::mutex> lg(lock);
+    return this->misses;
+}
+
+std::string PuzzleCache::resultKey(const std::string &canonical,
+                                   unsigned int nWords,
+                                   const SearchOptions &search) {
+    std::string key = canonical + "-" + std::to_string(nWords) + "-" +
+                      queryName(search.query);
+    if (search.query == SearchOptions::kFirst ||
+        search.query == SearchOptions::kBest) {
+        key += "-" + std::to_string(search.limit);
+    }
+    if (search.incremental && search.query != SearchOptions::kBest) {
+        key += "-incremental";
+    }
+    return key;
+}
+
+std::string PuzzleCache::resultFile(const std::string &key) const {
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx-",
+             static_cast<unsigned long long>(fingerprint));
+
+    // Letters that could not be part of a file name are written in hex.
+    std::string file = directory + "/" + name;
+    for (char ch : key) {
+        if (isalnum(static_cast<unsigned char>(ch)) || ch == '-') {
+            file += ch;
+        } else {
+            snprintf(name, sizeof(name), "%%%02x",
+                     static_cast<unsigned char>(ch));
+            file += name;
+        }
+    }
+    return file + ".lbc";
+}
+
+std::shared_ptr<const PuzzleCache::Result>
+PuzzleCache::load(const std::string &key,
+                  std::shared_ptr<const Puzzle> puzzle) {
+    std::ifstream in(resultFile(key), std::ios::binary);
+    char magic[sizeof(kMagic)];
+    uint64_t nFound;
+    uint32_t nBatches;
+    if (!in.read(magic, sizeof(magic)) ||
+        memcmp(magic, kMagic, sizeof(kMagic)) != 0 ||
+        !in.read(reinterpret_cast<char *>(&nFound), sizeof(nFound)) ||
+        !in.read(reinterpret_cast<char *>(&nBatches), sizeof(nBatches))) {
+        return nullptr;
+    }
+
+    std::unordered_map<uint32_t, const Word *> words;
+    for (const Word &word : puzzle->wordsStartingWith) words[word.id] = &word;
+
+    std::shared_ptr<Result> result = std::make_shared<Result>();
+    result->puzzle = puzzle;
+    result->nFound = nFound;
+    for (uint32_t i = 0; i < nBatches; i++) {
+        uint32_t nWords;
+        uint64_t nSolutions;
+        if (!in.read(reinterpret_cast<char *>(&nWords), sizeof(nWords)) ||
+            !in.read(reinterpret_cast<char *>(&nSolutions),
+                     sizeof(nSolutions)) ||
+            nWords == 0 || nWords > LetterBox::kMaxLetters ||
+            nSolutions > kMaxSolutions) {
+            return nullptr;
+        }
+
+        std::vector<uint32_t> ids(nWords * nSolutions);
+        if (!in.read(reinterpret_cast<char *>(ids.data()),
+                     ids.size() * sizeof(uint32_t))) {
+            return nullptr;
+        }
+
+        result->batches.emplace_back(nWords);
+        SolutionSet &batch = result->batches.back();
+        batch.words.reserve(ids.size());
+        for (uint32_t id : ids) {
+            auto it = words.find(id);
+            if (it == words.end()) return nullptr;
+            batch.words.push_back(it->second);
+        }
+    }
+    return result;
+}
+
+bool PuzzleCache::save(const std::string &key, const Result &result) const {
+    std::string file = resultFile(key);
+    size_t thread = std::hash<std::thread::id>()(std::this_thread::get_id());
+    std::string temporary = file + "." + std::to_string(getpid()) + "." +
+                            std::to_string(thread);
+    {
+        std::ofstream out(temporary, std::ios::binary);
+        uint32_t nBatches = result.batches.size();
+        out.write(kMagic, sizeof(kMagic));
+        out.write(reinterpret_cast<const char *>(&result.nFound),
+                  sizeof(result.nFound));
+        out.write(reinterpret_cast<const char *>(&nBatches), sizeof(nBatches));
+        for (const SolutionSet &batch : result.batches) {
+            uint32_t nWords = batch.nWords;
+            uint64_t nSolutions = batch.size();
+            out.write(reinterpret_cast<const char *>(&nWords), sizeof(nWords));
+            out.write(reinterpret_cast<const char *>(&nSolutions),
+                      sizeof(nSolutions));
+            for (const Word *word : batch.words) {
+                out.write(reinterpret_cast<const char *>(&word->id),
+                          sizeof(word->id));
+            }
+        }
+        if (!out) {
+            std::remove(temporary.c_str());
+            return false;
+        }
+    }
+    return std::rename(temporary.c_str(), file.c_str()) == 0;
+}
@@ -0,0 +1,168 @@
+/*
+ * File: puzzlecache.h
+ * Author: Jeremy Ephron
+ * ---------------------
+ * The interface for the PuzzleCache class, which remembers the filtered
+ * words and the solutions of the puzzles solved against a dictionary, so
+ * that a repeated query skips both filtering and searching.
+ *
+ * Puzzles are keyed by the canonical form of their letters (see
+ * LetterBox::canonicalLetters), so a box with its walls, or the letters of
+ * its walls, in another order is the same puzzle. Results are keyed by the
+ * puzzle, the number of words, the query and whether it is incremental,
+ * but not the engine: every engine finds the same solutions. Only results of
+ * at most kMaxSolutions solutions are kept.
+ *
+ * Both caches are LRU caches of capacity entries each. Given a directory,
+ * results are also written to a file each, named after a fingerprint of the
+ * dictionary and the key, and read back on a miss, so they outlive the
+ * process. The cache is safe to use from several threads at once.
+ */
+
+#ifndef Puzzle_Cache
+#define Puzzle_Cache
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "dictionaryindex.h"
+#include "letterbox.h"
+#include "maskindex.h"
+#include "search.h"
+#include "solutionset.h"
+#include "solutionstream.h"
+#include "taskpool.h"
+#include "word.h"
+#include "wordgraph.h"
+
+class PuzzleCache {
+public:  /* Interface */
+
+    /* The filtered words of a puzzle, laid out for the search. */
+    struct Puzzle {
+        LetterBox letterBox;
+        WordTable wordsStartingWith;
+        WordGraph graph;
+
+        /** Filters the words of a puzzle from a dictionary. */
+        Puzzle(const DictionaryIndex &dictionary, const MaskIndex &masks,
+               const std::string &letters);
+    };
+
+    /**
+     * Creates an empty cache of the puzzles of a dictionary, which must
+     * outlive it, keeping results in directory too unless it is empty.
+     */
+    PuzzleCache(const DictionaryIndex &dictionary,
+                size_t capacity = kDefaultCapacity,
+                const std::string &directory = "");
+
+    /**
+     * Returns the filtered words of a puzzle in canonical form, filtering
+     * them on a miss. The letters must be valid (see checkPuzzle).
+     */
+    std::shared_ptr<const Puzzle> puzzle(const std::string &letters);
+
+    /**
+     * Runs the query of search on a puzzle, handing its solutions to
+     * consumer in batches: on a hit straight from the cache, on the calling
+     * thread, and otherwise from the writer thread of a SolutionStream while
+     * the search runs. The letters must be valid (see checkPuzzle). A
+     * search stopped by search.limits is not cached, and neither is a shard
+     * (search.nShards above one), which is searched on the box as given.
+     *
+     * @returns the number of solutions found (or counted).
+     */
+    uint64_t solve(const std::string &letters, unsigned int nWords,
+                   const SearchOptions &search, TaskPool &pool,
+                   const SolutionStream::Consumer &consumer);
+
+    /** Returns the number of results found in the cache, and not. */
+    uint64_t numHits() const;
+    uint64_t numMisses() const;
+
+private:
+
+    /* The solutions of a query, as the batches they were found in. */
+    struct Result {
+        std::shared_ptr<const Puzzle> puzzle;  // the words solutions point to
+        std::vector<SolutionSet> batches;
+        uint64_t nFound = 0;
+    };
+
+    /* A map of at most capacity entries, dropping the least recently used. */
+    template <typename Value>
+    class Lru {
+    public:
+        explicit Lru(size_t capacity) : capacity(capacity) {}
+
+        std::shared_ptr<const Value> find(const std::string &key) {
+            auto it = index.find(key);
+            if (it == index.end()) return nullptr;
+            entries.splice(entries.begin(), entries, it->second);
+            return it->second->second;
+        }
+
+        void insert(const std::string &key,
+                    std::shared_ptr<const Value> value) {
+            if (capacity == 0) return;
+            auto it = index.find(key);
+            if (it != index.end()) entries.erase(it->second);
+            entries.emplace_front(key, std::move(value));
+            index[key] = entries.begin();
+            if (entries.size() > capacity) {
+                index.erase(entries.back().first);
+                entries.pop_back();
+            }
+        }
+
+    private:
+        using Entry = std::pair<std::string, std::shared_ptr<const Value> >;
+        std::list<Entry> entries;  // most recently used first
+        std::unordered_map<std::string,
+                           typename std::list<Entry>::iterator> index;
+        size_t capacity;
+    };
+
+    /** Returns the key of the result of a query on a canonical puzzle. */
+    static std::string resultKey(const std::string &canonical,
+                                 unsigned int nWords,
+                                 const SearchOptions &search);
+
+    /** Returns the file a result is kept in on disk. */
+    std::string resultFile(const std::string &key) const;
+
+    /** Reads a result from disk, returning nullptr if it is not there. */
+    std::shared_ptr<const Result> load(const std::string &key,
+                                       std::shared_ptr<const Puzzle> puzzle);
+
+    /** Writes a result to disk, returning false if it could not. */
+    bool save(const std::string &key, const Result &result) const;
+
+    const DictionaryIndex &dictionary;
+    MaskIndex masks;  // of the dictionary, to filter puzzles with
+    std::string directory;
+    uint64_t fingerprint;  // of the dictionary, when keeping results on disk
+
+    mutable std::mutex lock;  // guards everything below
+    Lru<Puzzle> puzzles;
+    Lru<Result> results;
+    uint64_t hits;
+    uint64_t misses;
+
+public:  /* public, but not necessary for most users */
+
+    static const size_t kDefaultCapacity;
+    static const size_t kMaxSolutions;
+    static const char kMagic[8];
+
+    PuzzleCache(const PuzzleCache &) = delete;
+    PuzzleCache &operator=(const PuzzleCache &) = delete;
+};
+
+#endif
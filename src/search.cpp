@@ -0,0 +1,1083 @@
+/*
+ * File: search.cpp
+ * Author: Jeremy Ephron
+ * ---------------------
+ * Implementation of the search for the solutions of a puzzle.
+ */
+
+#include "search.h"
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <sstream>
+#include <memory>
+#include <vector>
+#include "completiontable.h"
+#include "searchlimits.h"
+#include "searchstats.h"
+#include "supersetindex.h"
+#include "topsolutions.h"
+#include "wordfilter.h"
+
+using Path = std::vector<const WordGraph::Node *>;
+
+/* What every task of a search shares. */
+struct SearchControl {
+    bool countOnly = false;           // count complete paths, don't expand
+    bool incremental = false;         // record solutions of fewer words too
+    uint64_t limit = 0;               // solutions to stop after, 0 for all
+    std::atomic<bool> stop{false};    // set once limit solutions are found
+    std::atomic<unsigned int> nOpen{0};  // numbers of words short of limit
+    std::vector<std::atomic<uint64_t> > claimed;  // by number of words - 1
+    const CompletionTable *completions = nullptr;  // guides the search
+    TopSolutions *best = nullptr;     // keeps the best solutions, if ranking
+    SearchLimits *limits = nullptr;   // stop the search when hit, if any
+
+    /*
+     * Whether nWords more words starting with last can cover remaining, or,
+     * in an incremental search, at most nWords more words.
+     */
+    bool canComplete(unsigned int nWords, size_t last,
+                     LetterMask remaining) const {
+        if (completions == nullptr) return true;
+        if (!incremental) {
+            return completions->count(nWords, last, remaining) != 0;
+        }
+        for (unsigned int n = 0; n <= nWords; n++) {
+            if (completions->count(n, last, remaining) != 0) return true;
+        }
+        return false;
+    }
+
+    /* Whether more solutions of nWords words are wanted. */
+    bool wants(unsigned int nWords) const {
+        return limit == 0 ||
+               claimed[nWords - 1].load(std::memory_order_relaxed) < limit;
+    }
+
+    /* Whether solutions of length letters can rank among the best. */
+    bool canImprove(unsigned int length) const {
+        return best == nullptr || best->canImprove(length);
+    }
+};
+
+/* A level of the explicit stack of a search. */
+struct SearchFrame {
+    const WordGraph::Node *next;  // the next word class to try
+    const WordGraph::Node *end;   // the end of the classes to try
+    LetterMask remaining;         // letters not covered before this level
+    unsigned int length;          // letters in the shortest words before it
+};
+
+/*
+ * The state of the search tasks run by one worker, allocated once per search
+ * and reused by every task the worker runs.
+ */
+struct SearchState {
+    Path path;                    // the word classes chosen so far
+    std::vector<const Word *> words;  // room to expand path into words
+    std::vector<SearchFrame> frames;  // a frame per word of a solution
+    SolutionBuffer *found;        // the worker's buffer of each number of
+                                  // words, found[n - 1] for n words
+    SearchControl *control;       // shared by every task of the search
+    std::vector<uint64_t> count;  // solutions the worker found, likewise
+
+    // Classes left to visit before checking the limits, if any, and the
+    // solutions already added to them.
+    uint64_t untilCheck;
+    uint64_t nReported = 0;
+
+    // Solutions of the task being run that an earlier run already wrote.
+    uint64_t skip = 0;
+
+    // Only used when collecting statistics: counts points into depths then.
+    std::vector<SearchStats::Depth> depths;
+    SearchStats::Depth *counts = nullptr;
+    SearchStats::Duration busy{0};    // time spent running tasks
+
+    SearchState(unsigned int nWords, SolutionBuffer *found,
+                SearchControl *control, bool collectStats)
+        : path(nWords), words(nWords), frames(nWords), found(found),
+          control(control), count(nWords),
+          untilCheck(control->limits != nullptr
+                     ? SearchLimits::kCheckInterval : UINT64_MAX) {
+        if (collectStats) {
+            depths.resize(nWords);
+            counts = depths.data();
+        }
+    }
+
+    /* Whether the search as a whole is done and this task should return. */
+    bool stopped() const {
+        return control->stop.load(std::memory_order_relaxed);
+    }
+
+    /* Counts a class visited, checking the limits if it is time to. */
+    void tick() {
+        if (--untilCheck == 0) checkLimits();
+    }
+
+    /*
+     * Adds the classes visited and solutions found since the last check to
+     * the limits of the search, if any, and stops the search if one is hit.
+     */
+    void checkLimits() {
+        SearchLimits *limits = control->limits;
+        if (limits == nullptr) return;
+
+        uint64_t nFound = 0;
+        for (uint64_t n : count) nFound += n;
+        if (!limits->check(SearchLimits::kCheckInterval - untilCheck,
+                           nFound - nReported)) {
+            control->stop = true;
+        }
+        nReported = nFound;
+        untilCheck = SearchLimits::kCheckInterval;
+    }
+};
+
+/**
+ * Function: searchPaths
+ * ---------------------
+ * Finds every way of completing a path of word classes whose first depth
+ * classes are already chosen, given the letter the next word must start
+ * with and the letters not yet covered.
+ *
+ * The search chooses word classes of the WordGraph rather than words, and
+ * every complete path is expanded into a solution per choice of words.
+ *
+ * The search is a loop over an explicit stack, the frames of state, with a
+ * frame per word still to choose holding where it is in the classes of that
+ * level and the letters left before it. Letters are kept as a LetterMask, so
+ * covering the letters of a word is a single AND-NOT, and nothing is
+ * allocated while searching.
+ *
+ * Given a SupersetIndex, the last word is not searched for but looked up as
+ * the words starting with last that cover every remaining letter.
+ *
+ * With kIncremental, every path that covers every letter, including the
+ * first depth classes passed in, is also a solution of its own number of
+ * words. It is extended like any other path, and recorded once the frame
+ * extending it is done (or just before its last word is looked up), which
+ * keeps the check out of the loop over the classes of a frame. With
+ * kCollectStats, the classes visited and pruned at each depth are counted
+ * into state. Both are template parameters so that the search pays nothing
+ * for them when they are off.
+ *
+ * @param graph the filtered words of the puzzle.
+ * @param index the index used to find the last word, or nullptr.
+ * @param depth the number of word classes already in the path.
+ * @param last the index of the last letter typed, which our next word must
+ *             start with.
+ * @param remaining the mask of characters we haven't used yet.
+ * @param length the number of letters in the shortest words of the path.
+ * @param state the path being built up and where to put its solutions.
+ */
+template <bool kCollectStats, bool kIncremental>
+static void searchPaths(const WordGraph &graph, const SupersetIndex *index,
+                        size_t depth, size_t last, LetterMask remaining,
+                        unsigned int length, SearchState &state);
+
+/**
+ * Function: searchUnrolled
+ * ------------------------
+ * Does the same as searchPaths, for solutions of exactly kWords words.
+ *
+ * Rather than a loop over a stack of frames, each level of the search is a
+ * loop of its own, instantiated for its depth and nested in the loop of the
+ * level before, so that the words left, the last level and the one whose
+ * last word is looked up are all known when compiling. The checks of the
+ * loop of each level are the ones that apply there, the counters of its
+ * depth are fixed addresses, and the position in each level stays in a
+ * register rather than in a frame of state. searchFor() picks it for the
+ * word counts up to kMaxUnrolledWords and searchPaths for any other.
+ *
+ * @param graph the filtered words of the puzzle.
+ * @param index the index used to find the last word, or nullptr.
+ * @param depth the number of word classes already in the path.
+ * @param last the index of the last letter typed, which our next word must
+ *             start with.
+ * @param remaining the mask of characters we haven't used yet.
+ * @param length the number of letters in the shortest words of the path.
+ * @param state the path being built up and where to put its solutions.
+ */
+template <bool kCollectStats, bool kIncremental, unsigned int kWords>
+static void searchUnrolled(const WordGraph &graph, const SupersetIndex *index,
+                           size_t depth, size_t last, LetterMask remaining,
+                           unsigned int length, SearchState &state);
+
+/* The signature shared by searchPaths and searchUnrolled. */
+using PathSearch = void (*)(const WordGraph &graph, const SupersetIndex *index,
+                            size_t depth, size_t last, LetterMask remaining,
+                            unsigned int length, SearchState &state);
+
+// The most words per solution searchUnrolled is instantiated for.
+static const unsigned int kMaxUnrolledWords = 6;
+
+/**
+ * Function: searchFor
+ * -------------------
+ * Picks the search for solutions of nWords words: the instance of
+ * searchUnrolled for nWords if there is one, searchPaths otherwise.
+ *
+ * @param nWords the number of words per solution.
+ * @returns the search to run.
+ */
+template <bool kCollectStats, bool kIncremental>
+static PathSearch searchFor(unsigned int nWords);
+
+/**
+ * Function: lookUpLastWord
+ * ------------------------
+ * Completes a path of word classes that is one word short with every last
+ * word class the index finds: those starting with last that cover every
+ * letter of remaining. With kIncremental, first records the path as a
+ * solution of its own if it already covers every letter.
+ *
+ * @param graph the filtered words of the puzzle.
+ * @param index the index used to find the last word.
+ * @param nWords the number of words per solution.
+ * @param last the index of the letter the last word must start with.
+ * @param remaining the mask of characters the last word must cover.
+ * @param length the number of letters in the shortest words of the path.
+ * @param state the path being built up and where to put its solutions.
+ */
+template <bool kCollectStats, bool kIncremental>
+static void lookUpLastWord(const WordGraph &graph, const SupersetIndex &index,
+                           unsigned int nWords, size_t last,
+                           LetterMask remaining, unsigned int length,
+                           SearchState &state);
+
+/**
+ * Function: completePath
+ * ----------------------
+ * Records the solutions of a complete path of word classes: counts them as
+ * the product of the class sizes for a count query, and expands the path
+ * into them otherwise.
+ *
+ * @param graph the filtered words of the puzzle.
+ * @param state the complete path and where to put its solutions.
+ * @param nWords the length of the path, the first nWords classes of state.path.
+ */
+static void completePath(const WordGraph &graph, SearchState &state,
+                         unsigned int nWords);
+
+/**
+ * Function: expandPath
+ * --------------------
+ * Adds every solution a complete path of word classes stands for, one for
+ * each way of choosing a word from every class of the path, until the limit
+ * of the search, if any, is reached.
+ *
+ * @param graph the filtered words of the puzzle.
+ * @param state the complete path and where to put its solutions.
+ * @param nWords the number of classes of the path.
+ * @param depth the number of classes already expanded into words.
+ */
+static void expandPath(const WordGraph &graph, SearchState &state,
+                       unsigned int nWords, size_t depth = 0);
+
+/**
+ * Function: rankPath
+ * ------------------
+ * Offers every solution a complete path of word classes stands for to the
+ * TopSolutions of the search, skipping the choices of words that are already
+ * too long to rank among the best.
+ *
+ * @param graph the filtered words of the puzzle.
+ * @param state the complete path and the solutions kept so far.
+ * @param depth the number of classes already expanded into words.
+ * @param length the number of letters of the words already chosen.
+ */
+static void rankPath(const WordGraph &graph, SearchState &state,
+                     size_t depth = 0, unsigned int length = 0);
+
+/**
+ * Function: taskOf
+ * ----------------
+ * Numbers the task of generateSolutions that searches from a first word
+ * class, or from a first and second class for four or more words, for
+ * checkpoints and shards to refer to.
+ *
+ * @param graph the filtered words of the puzzle.
+ * @param first the first class of the task.
+ * @param second the second class of the task, or nullptr.
+ * @returns the number of the task.
+ */
+static uint64_t taskOf(const WordGraph &graph, const WordGraph::Node *first,
+                       const WordGraph::Node *second);
+
+/**
+ * Function: countShard
+ * --------------------
+ * Counts the solutions of the tasks of a shard from a CompletionTable,
+ * without searching: each task has as many as the paths completing it,
+ * times the words of its own classes.
+ *
+ * @param graph the filtered words of the puzzle.
+ * @param completions the table filled for solutions of nWords words.
+ * @param nWords the number of words per solution.
+ * @param search the options naming the shard.
+ * @returns the number of solutions of the shard.
+ */
+static uint64_t countShard(const WordGraph &graph,
+                           const CompletionTable &completions,
+                           unsigned int nWords, const SearchOptions &search);
+
+uint64_t generateSolutions(const WordGraph &graph, unsigned int nWords,
+                           const SearchOptions &search,
+                           SolutionSet &solutions, TaskPool &pool,
+                           SolutionStream *stream,
+                           std::vector<uint64_t> *nFoundByWords) {
+    using Node = WordGraph::Node;
+    using Clock = std::chrono::steady_clock;
+
+    SearchStats *stats = search.stats;
+    if (stats != nullptr) stats->addSearch();
+    SearchLimits *limits = search.limits;
+
+    // An incremental search finds the solutions of 1 to nWords words in one
+    // pass to depth nWords: a path of k words that covers every letter is a
+    // solution of k words, recorded on the way as the path is extended, so
+    // every shorter path is searched once rather than once per number of
+    // words. Only the solutions of nWords words are put in solutions; the
+    // rest are only streamed.
+    bool incremental = search.incremental &&
+                       search.query != SearchOptions::kBest;
+    if (nFoundByWords != nullptr) nFoundByWords->assign(nWords + 1, 0);
+
+    // A count query stores nothing: each task counts the solutions of a
+    // complete path of word classes as the product of the class sizes.
+    // Exists and first queries claim every solution against a shared limit,
+    // and the tasks return as soon as it is reached.
+    SearchControl control;
+    control.countOnly = search.query == SearchOptions::kCount;
+    control.incremental = incremental;
+    if (search.query == SearchOptions::kExists) control.limit = 1;
+    if (search.query == SearchOptions::kFirst) control.limit = search.limit;
+    control.nOpen = incremental ? nWords : 1;
+    control.claimed = std::vector<std::atomic<uint64_t> >(nWords);
+    control.limits = limits;
+
+    // With shards, a task is a first word for fewer than four words and a
+    // first and second word otherwise, numbered by taskOf() in the order of
+    // the graph, and belongs to shard task % nShards. The graph orders its
+    // classes by their letters and then by their words, so the same
+    // dictionary and box give the same tasks on any machine, and the
+    // solutions (or counts) of the shards add up to those of the search.
+    bool sharded = search.nShards > 1 && !incremental &&
+                   search.query != SearchOptions::kBest;
+    auto inShard = [&](uint64_t task) {
+        return !sharded || task % search.nShards == search.shard;
+    };
+
+    // Only an exhaustive search whose output is known can be checkpointed.
+    // The tasks done when it was loaded are not run again, those started
+    // skip the solutions they wrote then, and every task pushes its
+    // solutions to the stream once done, so that the checkpoint learns what
+    // the output holds. The solutions of earlier runs are not counted in
+    // the number returned; see Checkpoint::numFound().
+    Checkpoint *checkpoint = search.checkpoint;
+    if (incremental || control.limit != 0 ||
+        search.query == SearchOptions::kBest ||
+        (!control.countOnly && stream == nullptr)) {
+        checkpoint = nullptr;
+    }
+
+    // A best query is a branch and bound search: every solution is offered
+    // to a shared TopSolutions, and a partial solution that cannot be
+    // completed in as few letters as the worst solution kept is pruned. The
+    // solutions kept are returned (or streamed) best first at the end.
+    std::unique_ptr<TopSolutions> best;
+    if (search.query == SearchOptions::kBest) {
+        best.reset(new TopSolutions(nWords, search.limit));
+        control.best = best.get();
+    }
+
+    solutions = SolutionSet(nWords);
+
+    // The dp engine answers a count query (and an exists query without
+    // solutions) from its CompletionTable, a shard's from the counts of its
+    // tasks, and otherwise keeps the tasks from choosing a word that leads
+    // to no solution. An incremental table is filled for every number of
+    // words at once, and allows a word if any of them can complete it.
+    std::unique_ptr<CompletionTable> completions;
+    if (search.engine == SearchOptions::kDp) {
+        completions.reset(incremental ? new CompletionTable(graph, 1, nWords)
+                                      : new CompletionTable(graph, nWords));
+        control.completions = completions.get();
+        if (control.countOnly && sharded) {
+            uint64_t count = countShard(graph, *completions, nWords, search);
+            if (nFoundByWords != nullptr) (*nFoundByWords)[nWords] = count;
+            return count;
+        }
+        if (control.countOnly || completions->total() == 0) {
+            for (unsigned int n = 1; nFoundByWords != nullptr && n <= nWords;
+                 n++) {
+                (*nFoundByWords)[n] = completions->total(n);
+            }
+            return completions->total();
+        }
+    }
+
+    if (checkpoint != nullptr && stream != nullptr) {
+        stream->track([checkpoint](uint64_t task, size_t nSolutions,
+                                   bool done) {
+            checkpoint->recordWritten(task, nSolutions, done);
+        });
+    }
+
+    std::unique_ptr<SupersetIndex> index;
+    if (search.engine != SearchOptions::kDfs) {
+        index.reset(new SupersetIndex(graph));
+    }
+
+    // A buffer per worker and number of words, even if only the last is
+    // used: solution sets are cheap until something is added to them. With a
+    // stream, full buffers are pushed to it as the search goes and solutions
+    // is left empty; otherwise they are merged once the search is done.
+    std::vector<SolutionBuffer> buffers;
+    std::vector<std::unique_ptr<SearchState> > states;
+    buffers.reserve(pool.numThreads() * nWords);
+    for (size_t i = 0; i < pool.numThreads(); i++) {
+        for (unsigned int n = 1; n <= nWords; n++) {
+            buffers.emplace_back(n, stream);
+        }
+    }
+    for (size_t i = 0; i < pool.numThreads(); i++) {
+        states.emplace_back(new SearchState(nWords, &buffers[i * nWords],
+                                            &control, stats != nullptr));
+    }
+    LetterMask full = graph.fullMask();
+
+    // With limits, every worker checks them every kCheckInterval word
+    // classes it visits and at the end of each task, and the search stops,
+    // with the solutions found until then, as soon as one is hit. The
+    // subtrees of its progress are those of the first words.
+    //
+    // The tasks left of the subtree of each first word, when there are
+    // several: it is only done once the last of them is. A subtree the
+    // search stopped in the middle of is never done.
+    std::vector<std::atomic<unsigned int> > pending;
+    if (limits != nullptr && nWords >= 4) {
+        pending = std::vector<std::atomic<unsigned int> >(graph.size());
+    }
+    auto finishTask = [&](const Node *first) {
+        if (limits == nullptr || control.stop) return;
+        if (nWords < 4 || --pending[first - graph.begin()] == 0) {
+            limits->finishSubtree();
+        }
+    };
+
+    // The instance of the search this search runs.
+    PathSearch findPaths = stats != nullptr
+        ? (incremental ? searchFor<true, true>(nWords)
+                       : searchFor<true, false>(nWords))
+        : (incremental ? searchFor<false, true>(nWords)
+                       : searchFor<false, false>(nWords));
+
+    // Searches on from the first word, and the second if there is one.
+    auto searchFrom = [&](const Node *first, const Node *second,
+                          LetterMask remaining) {
+        SearchState &state = *states[TaskPool::workerIndex()];
+        if (state.stopped()) {
+            finishTask(first);
+            return;
+        }
+
+        Clock::time_point start;
+        if (stats != nullptr) start = Clock::now();
+
+        state.path[0] = first;
+        unsigned int length = first->minLength;
+        const Node *last = first;
+        if (second != nullptr) {
+            state.path[1] = second;
+            length += second->minLength;
+            last = second;
+        }
+
+        Checkpoint::Task task = 0;
+        uint64_t nCounted = state.count[nWords - 1];
+        if (checkpoint != nullptr) {
+            task = taskOf(graph, first, second);
+            state.skip = checkpoint->numWritten(task);
+            state.found[nWords - 1].task = task;
+        }
+
+        size_t depth = second == nullptr ? 1 : 2;
+        findPaths(graph, index.get(), depth, last->last, remaining, length,
+                  state);
+        if (checkpoint != nullptr) {
+            bool done = !state.stopped();
+            if (!control.countOnly) {
+                state.found[nWords - 1].finish(done);
+            } else if (done) {
+                checkpoint->recordCount(task,
+                                        state.count[nWords - 1] - nCounted);
+            }
+        }
+        finishTask(first);
+        state.checkLimits();
+        if (stats != nullptr) state.busy += Clock::now() - start;
+    };
+
+    // The tasks of this search, which may share the pool with other searches.
+    // Each first word is a task of its own, and for four or more words it
+    // splits into a task per second word, so that idle workers can steal
+    // part of the larger subtrees.
+    TaskPool::Group group;
+    SearchStats::Depth firstDepth;  // counted here rather than by a worker
+    for (const Node *first = graph.begin(); first != graph.end(); first++) {
+        LetterMask remaining = full & ~first->mask;
+        firstDepth.visited++;
+        if (!control.canComplete(nWords - 1, first->last, remaining)) {
+            firstDepth.pruned++;
+            continue;
+        }
+        if (nWords < 4) {
+            uint64_t task = taskOf(graph, first, nullptr);
+            if (!inShard(task)) continue;
+            if (checkpoint != nullptr && checkpoint->isDone(task)) continue;
+        }
+        if (limits != nullptr) {
+            limits->addSubtrees(1);
+            if (nWords >= 4) pending[first - graph.begin()] = 1;
+        }
+        if (nWords < 4) {
+            pool.submit([&searchFrom, first, remaining] {
+                searchFrom(first, nullptr, remaining);
+            }, group);
+            continue;
+        }
+
+        pool.submit([&, first, remaining] {
+            SearchState &state = *states[TaskPool::workerIndex()];
+            Clock::time_point start;
+            if (stats != nullptr) start = Clock::now();
+
+            if (incremental && remaining == 0) {
+                state.path[0] = first;
+                completePath(graph, state, 1);
+            }
+            for (const Node *second = graph.begin(first->last);
+                 second != graph.end(first->last) && !control.stop;
+                 second++) {
+                if (state.counts != nullptr) state.counts[1].visited++;
+                state.tick();
+                if (!control.canComplete(nWords - 2, second->last,
+                                         remaining & ~second->mask)) {
+                    if (state.counts != nullptr) state.counts[1].pruned++;
+                    continue;
+                }
+                uint64_t task = taskOf(graph, first, second);
+                if (!inShard(task)) continue;
+                if (checkpoint != nullptr && checkpoint->isDone(task)) {
+                    continue;
+                }
+                if (limits != nullptr) pending[first - graph.begin()]++;
+                pool.submit([&searchFrom, first, second, remaining] {
+                    searchFrom(first, second, remaining & ~second->mask);
+                });
+            }
+            finishTask(first);
+            if (stats != nullptr) state.busy += Clock::now() - start;
+        }, group);
+    }
+
+    pool.wait(group);
+    if (limits != nullptr) limits->reportNow();
+
+    // Every worker counted the classes it visited and pruned at each depth,
+    // and timed the tasks it ran.
+    if (stats != nullptr) {
+        states[0]->depths[0].visited += firstDepth.visited;
+        states[0]->depths[0].pruned += firstDepth.pruned;
+        for (size_t i = 0; i < states.size(); i++) {
+            stats->addDepths(states[i]->depths);
+            stats->addBusyTime(i, states[i]->busy);
+        }
+    }
+
+    if (best != nullptr) {
+        solutions = best->sorted();
+        uint64_t nFound = solutions.size();
+        if (stream != nullptr && nFound != 0) stream->push(solutions);
+        if (nFoundByWords != nullptr) (*nFoundByWords)[nWords] = nFound;
+        return nFound;
+    }
+
+    uint64_t nFound = 0;
+    for (size_t i = 0; i < states.size(); i++) {
+        for (unsigned int n = 1; n <= nWords; n++) {
+            SolutionBuffer &buffer = states[i]->found[n - 1];
+            buffer.flush();
+            if (n == nWords) solutions.append(buffer.solutions);
+            nFound += states[i]->count[n - 1];
+            if (nFoundByWords != nullptr) {
+                (*nFoundByWords)[n] += states[i]->count[n - 1];
+            }
+        }
+    }
+    return nFound;
+}
+
+template <bool kCollectStats, bool kIncremental>
+void searchPaths(const WordGraph &graph, const SupersetIndex *index,
+                 size_t depth, size_t last, LetterMask remaining,
+                 unsigned int length, SearchState &state) {
+    using Node = WordGraph::Node;
+
+    const size_t nWords = state.path.size();
+    const SearchControl &control = *state.control;
+    if (depth == nWords) {
+        if (remaining == 0) completePath(graph, state, nWords);
+        return;
+    }
+
+    if (nWords - depth == 1 && index != nullptr) {
+        lookUpLastWord<kCollectStats, kIncremental>(graph, *index, nWords,
+                                                    last, remaining, length,
+                                                    state);
+        return;
+    }
+
+    const size_t base = depth;
+    SearchFrame *frame = &state.frames[depth];
+    *frame = {graph.begin(last), graph.end(last), remaining, length};
+
+    while (true) {
+        if (frame->next == frame->end || state.stopped()) {
+            if (kIncremental && frame->remaining == 0) {
+                completePath(graph, state, depth);
+            }
+            if (depth == base) return;
+            depth--;
+            frame--;
+            continue;
+        }
+
+        size_t nLeft = nWords - depth;
+        const Node *node = frame->next++;
+        LetterMask left = frame->remaining & ~node->mask;
+        unsigned int extended = frame->length + node->minLength;
+        if (kCollectStats) state.counts[depth].visited++;
+        state.tick();
+        if ((nLeft == 1 && left != 0) ||
+            !control.canComplete(nLeft - 1, node->last, left) ||
+            !control.canImprove(
+                extended + (nLeft - 1) * LetterBox::kMinWordLength)) {
+            if (kCollectStats) state.counts[depth].pruned++;
+            continue;
+        }
+
+        state.path[depth] = node;
+        if (nLeft == 1) {
+            completePath(graph, state, nWords);
+            continue;
+        }
+        if (nLeft == 2 && index != nullptr) {
+            lookUpLastWord<kCollectStats, kIncremental>(graph, *index, nWords,
+                                                        node->last, left,
+                                                        extended, state);
+            continue;
+        }
+
+        depth++;
+        frame++;
+        *frame = {graph.begin(node->last), graph.end(node->last), left,
+                  extended};
+    }
+}
+
+/*
+ * The level of searchUnrolled that chooses the word at depth kWords - kLeft
+ * of the path, kLeft words before its end.
+ */
+template <bool kCollectStats, bool kIncremental, unsigned int kWords,
+          unsigned int kLeft>
+struct UnrolledLevel {
+    using Node = WordGraph::Node;
+    using Next = UnrolledLevel<kCollectStats, kIncremental, kWords, kLeft - 1>;
+    static const size_t kDepth = kWords - kLeft;
+
+    // Kept out of line: with every level inlined into the first, the loop
+    // of the last level, where most of the time goes, compiles worse.
+    __attribute__((noinline))
+    static void search(const WordGraph &graph, const SupersetIndex *index,
+                       size_t last, LetterMask remaining, unsigned int length,
+                       SearchState &state) {
+        const SearchControl &control = *state.control;
+        if (kLeft == 1 && index != nullptr) {
+            lookUpLastWord<kCollectStats, kIncremental>(graph, *index, kWords,
+                                                        last, remaining,
+                                                        length, state);
+            return;
+        }
+
+        const Node *end = graph.end(last);
+        for (const Node *node = graph.begin(last);
+             node != end && !state.stopped(); node++) {
+            LetterMask left = remaining & ~node->mask;
+            unsigned int extended = length + node->minLength;
+            if (kCollectStats) state.counts[kDepth].visited++;
+            state.tick();
+            if ((kLeft == 1 && left != 0) ||
+                !control.canComplete(kLeft - 1, node->last, left) ||
+                !control.canImprove(
+                    extended + (kLeft - 1) * LetterBox::kMinWordLength)) {
+                if (kCollectStats) state.counts[kDepth].pruned++;
+                continue;
+            }
+
+            state.path[kDepth] = node;
+            if (kLeft == 1) {
+                completePath(graph, state, kWords);
+            } else if (kLeft == 2 && index != nullptr) {
+                lookUpLastWord<kCollectStats, kIncremental>(
+                    graph, *index, kWords, node->last, left, extended, state);
+            } else {
+                Next::search(graph, index, node->last, left, extended, state);
+            }
+        }
+        if (kIncremental && remaining == 0) {
+            completePath(graph, state, kDepth);
+        }
+    }
+
+    /* Searches from the level at depth, this one or one after it. */
+    static void enter(const WordGraph &graph, const SupersetIndex *index,
+                      size_t depth, size_t last, LetterMask remaining,
+                      unsigned int length, SearchState &state) {
+        if (depth == kDepth) {
+            search(graph, index, last, remaining, length, state);
+        } else {
+            Next::enter(graph, index, depth, last, remaining, length, state);
+        }
+    }
+};
+
+/* The end of the path: it is a solution if it covers every letter. */
+template <bool kCollectStats, bool kIncremental, unsigned int kWords>
+struct UnrolledLevel<kCollectStats, kIncremental, kWords, 0> {
+    static void search(const WordGraph &graph, const SupersetIndex *,
+                       size_t, LetterMask remaining, unsigned int,
+                       SearchState &state) {
+        if (remaining == 0) completePath(graph, state, kWords);
+    }
+
+    static void enter(const WordGraph &graph, const SupersetIndex *index,
+                      size_t, size_t last, LetterMask remaining,
+                      unsigned int length, SearchState &state) {
+        search(graph, index, last, remaining, length, state);
+    }
+};
+
+template <bool kCollectStats, bool kIncremental, unsigned int kWords>
+void searchUnrolled(const WordGraph &graph, const SupersetIndex *index,
+                    size_t depth, size_t last, LetterMask remaining,
+                    unsigned int length, SearchState &state) {
+    UnrolledLevel<kCollectStats, kIncremental, kWords, kWords>::enter(
+        graph, index, depth, last, remaining, length, state);
+}
+
+template <bool kCollectStats, bool kIncremental>
+PathSearch searchFor(unsigned int nWords) {
+    switch (nWords) {
+        case 1: return searchUnrolled<kCollectStats, kIncremental, 1>;
+        case 2: return searchUnrolled<kCollectStats, kIncremental, 2>;
+        case 3: return searchUnrolled<kCollectStats, kIncremental, 3>;
+        case 4: return searchUnrolled<kCollectStats, kIncremental, 4>;
+        case 5: return searchUnrolled<kCollectStats, kIncremental, 5>;
+        case 6: return searchUnrolled<kCollectStats, kIncremental, 6>;
+        default: return searchPaths<kCollectStats, kIncremental>;
+    }
+}
+
+template <bool kCollectStats, bool kIncremental>
+void lookUpLastWord(const WordGraph &graph, const SupersetIndex &index,
+                    unsigned int nWords, size_t last, LetterMask remaining,
+                    unsigned int length, SearchState &state) {
+    using Node = WordGraph::Node;
+
+    const SearchControl &control = *state.control;
+    if (kIncremental && remaining == 0) {
+        completePath(graph, state, nWords - 1);
+    }
+    index.forEachSuperset(last, remaining, [&](const Node *node) {
+        if (state.stopped()) return;
+        if (kCollectStats) state.counts[nWords - 1].visited++;
+        state.tick();
+        if (!control.canImprove(length + node->minLength)) {
+            if (kCollectStats) state.counts[nWords - 1].pruned++;
+            return;
+        }
+        state.path[nWords - 1] = node;
+        completePath(graph, state, nWords);
+    });
+}
+
+void completePath(const WordGraph &graph, SearchState &state,
+                  unsigned int nWords) {
+    if (state.control->best != nullptr) {
+        rankPath(graph, state);
+        return;
+    }
+
+    if (!state.control->countOnly) {
+        if (state.control->wants(nWords)) expandPath(graph, state, nWords);
+        return;
+    }
+
+    uint64_t nSolutions = 1;
+    for (unsigned int i = 0; i < nWords; i++) {
+        nSolutions *= state.path[i]->size();
+    }
+    state.count[nWords - 1] += nSolutions;
+}
+
+uint64_t taskOf(const WordGraph &graph, const WordGraph::Node *first,
+                const WordGraph::Node *second) {
+    uint64_t task = first - graph.begin();
+    if (second != nullptr) {
+        task = task * graph.size() + (second - graph.begin());
+    }
+    return task;
+}
+
+uint64_t countShard(const WordGraph &graph,
+                    const CompletionTable &completions, unsigned int nWords,
+                    const SearchOptions &search) {
+    uint64_t total = 0;
+    LetterMask full = graph.fullMask();
+    for (const WordGraph::Node *first = graph.begin(); first != graph.end();
+         first++) {
+        LetterMask remaining = full & ~first->mask;
+        if (nWords < 4) {
+            if (taskOf(graph, first, nullptr) % search.nShards ==
+                search.shard) {
+                total += first->size() *
+                         completions.count(nWords - 1, first->last,
+                                           remaining);
+            }
+            continue;
+        }
+
+        for (const WordGraph::Node *second = graph.begin(first->last);
+             second != graph.end(first->last); second++) {
+            if (taskOf(graph, first, second) % search.nShards !=
+                search.shard) {
+                continue;
+            }
+            total += first->size() * second->size() *
+                     completions.count(nWords - 2, second->last,
+                                       remaining & ~second->mask);
+        }
+    }
+    return total;
+}
+
+void expandPath(const WordGraph &graph, SearchState &state,
+                unsigned int nWords, size_t depth) {
+    SearchControl &control = *state.control;
+    if (depth == nWords) {
+        if (state.skip != 0) {
+            state.skip--;
+            return;
+        }
+        if (control.limit != 0) {
+            uint64_t claimed = control.claimed[nWords - 1]++;
+            if (claimed + 1 == control.limit && --control.nOpen == 0) {
+                control.stop = true;
+            }
+            if (claimed >= control.limit) return;
+        }
+
+        state.found[nWords - 1].add(state.words.data());
+        state.count[nWords - 1]++;
+        return;
+    }
+
+    const WordGraph::Node &node = *state.path[depth];
+    const Word *const *words = graph.words(node);
+    for (size_t i = 0;
+         i < node.size() && !state.stopped() && control.wants(nWords); i++) {
+        state.words[depth] = words[i];
+        expandPath(graph, state, nWords, depth + 1);
+    }
+}
+
+void rankPath(const WordGraph &graph, SearchState &state, size_t depth,
+              unsigned int length) {
+    TopSolutions &best = *state.control->best;
+    if (depth == state.path.size()) {
+        best.offer(state.words.data(), length);
+        return;
+    }
+
+    const WordGraph::Node &node = *state.path[depth];
+    const Word *const *words = graph.words(node);
+    for (size_t i = 0; i < node.size(); i++) {
+        unsigned int extended = length + words[i]->size();
+        if (!best.canImprove(extended)) continue;
+
+        state.words[depth] = words[i];
+        rankPath(graph, state, depth + 1, extended);
+    }
+}
+
+uint64_t solvePuzzle(const WordGraph &graph, unsigned int nWords,
+                     const SearchOptions &search, TaskPool &pool,
+                     SolutionStream *stream,
+                     std::vector<uint64_t> *nFoundByWords) {
+    SolutionSet solutions;
+    if (search.query != SearchOptions::kBest) {
+        return generateSolutions(graph, nWords, search, solutions, pool,
+                                 stream, nFoundByWords);
+    }
+
+    if (nFoundByWords != nullptr) nFoundByWords->assign(nWords + 1, 0);
+    SearchOptions pass = search;
+    uint64_t nFound = 0;
+    for (unsigned int n = 1; n <= nWords && nFound < search.limit &&
+                             (search.limits == nullptr ||
+                              !search.limits->stopped());
+         n++) {
+        pass.limit = search.limit - nFound;
+        uint64_t nPass = generateSolutions(graph, n, pass, solutions, pool,
+                                           stream);
+        if (nFoundByWords != nullptr) (*nFoundByWords)[n] = nPass;
+        nFound += nPass;
+    }
+    return nFound;
+}
+
+bool isValidLetters(const std::string &letters) {
+    return letters.length() % LetterBox::kNumWalls == 0 &&
+           letters.length() <= LetterBox::kMaxLetters;
+}
+
+unsigned int maxNumWords(const LetterBox &letterBox) {
+    return letterBox.numLetters() / LetterBox::kMinWordLength;
+}
+
+bool checkPuzzle(std::string &letters, unsigned int nWords,
+                 std::string &error) {
+    for (char &ch : letters) ch = toupper(ch);
+    if (!isValidLetters(letters)) {
+        error = "invalid letters \"" + letters + "\"";
+        return false;
+    }
+
+    unsigned int maxWords = maxNumWords(LetterBox(letters));
+    if (nWords < 1 || nWords > maxWords) {
+        error = "number of words must be between 1 and " +
+                std::to_string(maxWords);
+        return false;
+    }
+    return true;
+}
+
+bool parsePuzzle(const std::string &line, std::string &letters,
+                 unsigned int &nWords, SearchOptions &search,
+                 std::string &error, SearchLimits *limits) {
+    std::istringstream request(line);
+    if (!(request >> letters)) {
+        error = "missing letters";
+        return false;
+    }
+
+    int n = 0;
+    request >> n;
+    if (!checkPuzzle(letters, n < 0 ? 0 : n, error)) return false;
+
+    std::string word;
+    bool haveWord = static_cast<bool>(request >> word);
+    if (haveWord && (limits == nullptr ||
+                     (word != "timeout" && word != "budget"))) {
+        SearchOptions requested = search;
+        long long k = 0;
+        if (!parseQuery(word, requested) ||
+            ((requested.query == SearchOptions::kFirst ||
+              requested.query == SearchOptions::kBest) &&
+             (!(request >> k) || k < 1))) {
+            error = "query must be all, count, exists, first <k> or best <k>";
+            return false;
+        }
+        requested.limit = k;
+        search = requested;
+        haveWord = limits != nullptr && request >> word;
+    }
+
+    for (; haveWord; haveWord = static_cast<bool>(request >> word)) {
+        long long k = 0;
+        if ((word != "timeout" && word != "budget") || !(request >> k) ||
+            k < 1) {
+            error = "limits must be timeout <ms> or budget <classes>";
+            return false;
+        }
+        if (word == "timeout") {
+            limits->setTimeout(std::chrono::milliseconds(k));
+        } else {
+            limits->setBudget(k);
+        }
+    }
+
+    nWords = n;
+    return true;
+}
+
+bool parseQuery(const std::string &name, SearchOptions &search) {
+    if (name == "all") {
+        search.query = SearchOptions::kAll;
+    } else if (name == "count") {
+        search.query = SearchOptions::kCount;
+    } else if (name == "exists") {
+        search.query = SearchOptions::kExists;
+    } else if (name == "first") {
+        search.query = SearchOptions::kFirst;
+    } else if (name == "best") {
+        search.query = SearchOptions::kBest;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/* Adds the words of the entries that passed a WordFilter to a table. */
+static void addWords(const DictionaryIndex &dictionary,
+                     const LetterBox &letterBox,
+                     const std::vector<const DictionaryIndex::Entry *> &matches,
+                     WordTable &wordsStartingWith) {
+    wordsStartingWith.reserve(wordsStartingWith.size() + matches.size());
+    for (const DictionaryIndex::Entry *entry : matches) {
+        const char *text = dictionary.text(*entry);
+        wordsStartingWith.emplace_back(
+            text, entry->length, letterBox.letterMask(text, entry->length),
+            dictionary.id(*entry));
+    }
+}
+
+void buildFilteredWordList(const DictionaryIndex &dictionary,
+                           const LetterBox &letterBox,
+                           WordTable &wordsStartingWith) {
+    if (!dictionary.isOpen()) return;
+
+    WordFilter filter(letterBox);
+    std::vector<const DictionaryIndex::Entry *> matches;
+    for (char first : letterBox.getLetters()) {
+        filter.filter(dictionary, first, matches);
+    }
+    addWords(dictionary, letterBox, matches, wordsStartingWith);
+}
+
+void buildFilteredWordList(const DictionaryIndex &dictionary,
+                           const MaskIndex &masks, const LetterBox &letterBox,
+                           WordTable &wordsStartingWith) {
+    if (!dictionary.isOpen()) return;
+
+    WordFilter filter(letterBox);
+    std::vector<const DictionaryIndex::Entry *> matches;
+    filter.filter(dictionary, masks, matches);
+    addWords(dictionary, letterBox, matches, wordsStartingWith);
+}
@@ -0,0 +1,222 @@
+/*
+ * File: search.h
+ * Author: Jeremy Ephron
+ * ---------------------
+ * The search for the solutions of a puzzle: filtering the dictionary down to
+ * the words of a letter box, and finding the solutions of its WordGraph on a
+ * TaskPool, with any of the engines and queries of SearchOptions.
+ */
+
+#ifndef Search_h
+#define Search_h
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "checkpoint.h"
+#include "dictionaryindex.h"
+#include "letterbox.h"
+#include "maskindex.h"
+#include "searchlimits.h"
+#include "searchstats.h"
+#include "solutionset.h"
+#include "solutionstream.h"
+#include "taskpool.h"
+#include "word.h"
+#include "wordgraph.h"
+
+/* How the solutions of a puzzle are searched for. */
+struct SearchOptions {
+    // kDfs tries every word at every level. kJoin does the same except for
+    // the last word, which is looked up in a SupersetIndex. kDp is kJoin
+    // guided by a CompletionTable, which skips every word that cannot lead
+    // to a solution and counts solutions without searching at all.
+    enum Engine { kDfs, kJoin, kDp };
+
+    // kAll finds every solution, kCount only counts them, kExists stops at
+    // the first solution and kFirst after limit of them. kBest keeps the
+    // limit solutions with the fewest letters.
+    enum Query { kAll, kCount, kExists, kFirst, kBest };
+
+    Engine engine = kJoin;
+    Query query = kAll;
+    uint64_t limit = 0;
+
+    // Also find the solutions of fewer words: those of every number of words
+    // up to the one asked for, in a single search, with the query applying
+    // to each number of words on its own. A best query already tries fewer
+    // words first and ignores it.
+    bool incremental = false;
+
+    // Where to add the statistics of the search, if anywhere.
+    SearchStats *stats = nullptr;
+
+    // The deadline, budget and cancellation flag to stop the search at, and
+    // where to report its progress, if anywhere.
+    SearchLimits *limits = nullptr;
+
+    // Where to keep how far the search has got, and what to resume from, if
+    // anywhere. Only used by all and count queries that are not incremental,
+    // and for an all query only with a stream.
+    Checkpoint *checkpoint = nullptr;
+
+    // Only search shard out of nShards, a slice of the tasks of the search
+    // that the other shards do not search (see taskOf() in search.cpp). Not
+    // used by best queries or incremental searches.
+    unsigned int shard = 0;
+    unsigned int nShards = 1;
+};
+
+/**
+ * Function: isValidLetters
+ * ------------------------
+ * Checks whether a string of letters can make up a letter box.
+ *
+ * @param letters the letters of each wall, typed in consecutively.
+ * @returns true if the letters split evenly into walls and fit in a mask.
+ */
+bool isValidLetters(const std::string &letters);
+
+/**
+ * Function: maxNumWords
+ * ---------------------
+ * The largest number of words a solution to a letter box can need.
+ *
+ * @param letterBox the LetterBox puzzle object.
+ * @returns the maximum number of words in a solution.
+ */
+unsigned int maxNumWords(const LetterBox &letterBox);
+
+/**
+ * Function: checkPuzzle
+ * ---------------------
+ * Checks that letters make up a letter box and that it has solutions of
+ * nWords words, uppercasing the letters.
+ *
+ * @param letters the letters of each wall, typed in consecutively.
+ * @param nWords the number of words per solution.
+ * @param error set to a description of the problem if the puzzle is invalid.
+ * @returns true if the puzzle is valid, false otherwise.
+ */
+bool checkPuzzle(std::string &letters, unsigned int nWords,
+                 std::string &error);
+
+/**
+ * Function: parsePuzzle
+ * ---------------------
+ * Parses a "<letters> <n> [query]" puzzle request, uppercasing the letters.
+ * The query, if any, is "all", "count", "exists", "first <k>" or
+ * "best <k>", and overrides the one search was set to.
+ *
+ * Given limits, the request may end in "timeout <ms>", to stop searching
+ * that many milliseconds from now, and "budget <classes>", to stop after
+ * visiting that many word classes, which are set on them.
+ *
+ * @param line the request.
+ * @param letters set to the letters of the letter box.
+ * @param nWords set to the number of words per solution.
+ * @param search the search options, whose query the request may change.
+ * @param error set to a description of the problem if the request is invalid.
+ * @param limits the limits a request may set, or nullptr.
+ * @returns true if the request is a valid puzzle, false otherwise.
+ */
+bool parsePuzzle(const std::string &line, std::string &letters,
+                 unsigned int &nWords, SearchOptions &search,
+                 std::string &error, SearchLimits *limits = nullptr);
+
+/**
+ * Function: parseQuery
+ * --------------------
+ * Sets the query of a search from its name, leaving the limit of a "first"
+ * or "best" query for the caller to set.
+ *
+ * @param name the name of the query.
+ * @param search the search options to be updated.
+ * @returns true if the name is a known query, false otherwise.
+ */
+bool parseQuery(const std::string &name, SearchOptions &search);
+
+/**
+ * Function: buildFilteredWordList
+ * -------------------------------
+ * Filters words from a dictionary and populates a table with words grouped by
+ * starting character.
+ *
+ * Only the words starting with a letter of the box are looked at, and they
+ * are checked many at a time by a WordFilter. The table is grown once, and
+ * its Words refer to the text of the dictionary rather than copy it.
+ *
+ * @param dictionary the loaded dictionary (or index) to use.
+ * @param letterBox the LetterBox puzzle object.
+ * @param wordsStartingWith the table the words of the puzzle are added to.
+ */
+void buildFilteredWordList(const DictionaryIndex &dictionary,
+                           const LetterBox &letterBox,
+                           WordTable &wordsStartingWith);
+
+/**
+ * Function: buildFilteredWordList
+ * -------------------------------
+ * Filters words from a dictionary as above, but only looks at the candidates
+ * a MaskIndex of it finds, the words made of letters of the box, rather than
+ * at every word starting with one. The table holds the same words either
+ * way, in another order, which the WordGraph of the words sorts anyway.
+ *
+ * @param dictionary the loaded dictionary (or index) to use.
+ * @param masks the mask index of the dictionary.
+ * @param letterBox the LetterBox puzzle object.
+ * @param wordsStartingWith the table the words of the puzzle are added to.
+ */
+void buildFilteredWordList(const DictionaryIndex &dictionary,
+                           const MaskIndex &masks, const LetterBox &letterBox,
+                           WordTable &wordsStartingWith);
+
+/**
+ * Function: generateSolutions
+ * ---------------------------
+ * Generates the solutions of a fixed number of words, or as many of them as
+ * the query of search asks for, on the workers of pool, with the engine,
+ * limits, checkpoint and shard of search.
+ *
+ * @param graph the filtered words of the puzzle.
+ * @param nWords the number of words per solution.
+ * @param search how to search.
+ * @param solutions the set of solutions to be populated.
+ * @param pool the pool the search tasks are run on.
+ * @param stream the stream solutions are written to, if any.
+ * @param nFoundByWords set to the number of solutions found of each number
+ *                      of words, indexed by it, if not nullptr.
+ * @returns the number of solutions found (or counted).
+ */
+uint64_t generateSolutions(const WordGraph &graph, unsigned int nWords,
+                           const SearchOptions &search,
+                           SolutionSet &solutions, TaskPool &pool,
+                           SolutionStream *stream = nullptr,
+                           std::vector<uint64_t> *nFoundByWords = nullptr);
+
+/**
+ * Function: solvePuzzle
+ * ---------------------
+ * Runs the query of search on a puzzle, streaming what it finds.
+ *
+ * A best query tries solutions of one word, then two, and so on up to nWords,
+ * until it has found as many solutions as it asks for (or a limit of
+ * search.limits stops it): any solution with fewer words ranks before every
+ * solution with more.
+ *
+ * @param graph the filtered words of the puzzle.
+ * @param nWords the number of words per solution, or the most words per
+ *               solution for a best query.
+ * @param search how to search, and for what.
+ * @param pool the pool the search tasks are run on.
+ * @param stream the stream solutions are written to, if any.
+ * @param nFoundByWords set to the number of solutions found of each number
+ *                      of words, indexed by it, if not nullptr.
+ * @returns the number of solutions found (or counted).
+ */
+uint64_t solvePuzzle(const WordGraph &graph, unsigned int nWords,
+                     const SearchOptions &search, TaskPool &pool,
+                     SolutionStream *stream = nullptr,
+                     std::vector<uint64_t> *nFoundByWords = nullptr);
+
+#endif
@@ -0,0 +1,112 @@
+/*
+ * File: searchlimits.cpp
+ * Author: Jeremy Ephron
+ * ------------------------
+ * The implementation of the SearchLimits class.
+ */
+
+#include "searchlimits.h"
+
+const uint64_t SearchLimits::kCheckInterval = 4096;
+
+SearchLimits::SearchLimits()
+    : cancelled(false), stoppedBy(kFinished),
+      deadline(Clock::time_point::max()), budget(0), nSubtrees(0),
+      nSubtreesDone(0), nFound(0), nVisited(0), interval(0),
+      nextReport(Clock::time_point::min()) {}
+
+void SearchLimits::cancel() {
+    cancelled.store(true, std::memory_order_relaxed);
+}
+
+void SearchLimits::setDeadline(Clock::time_point deadline) {
+    this->deadline = deadline;
+}
+
+void SearchLimits::setTimeout(Clock::duration timeout) {
+    this->deadline = Clock::now() + timeout;
+}
+
+void SearchLimits::setBudget(uint64_t nClasses) {
+    this->budget = nClasses;
+}
+
+void SearchLimits::onProgress(ProgressCallback callback,
+                              Clock::duration interval) {
+    this->callback = std::move(callback);
+    this->interval = interval;
+    this->nextReport = Clock::now() + interval;
+}
+
+bool SearchLimits::stopped() const {
+    return stoppedBy.load(std::memory_order_relaxed) != kFinished;
+}
+
+SearchLimits::Outcome SearchLimits::outcome() const {
+    return Outcome(stoppedBy.load(std::memory_order_relaxed));
+}
+
+SearchLimits::Progress SearchLimits::progress() const {
+    Progress progress;
+    progress.nSubtrees = nSubtrees.load(std::memory_order_relaxed);
+    progress.nSubtreesDone = nSubtreesDone.load(std::memory_order_relaxed);
+    progress.nFound = nFound.load(std::memory_order_relaxed);
+    progress.nVisited = nVisited.load(std::memory_order_relaxed);
+    return progress;
+}
+
+const char *SearchLimits::outcomeName(Outcome outcome) {
+    switch (outcome) {
+        case kFinished: return "finished";
+        case kCancelled: return "cancelled";
+        case kDeadline: return "deadline";
+        case kBudget: return "budget";
+    }
+    return "";
+}
+
+void SearchLimits::stop(Outcome reason) {
+    int finished = kFinished;
+    stoppedBy.compare_exchange_strong(finished, reason);
+}
+
+void SearchLimits::report(Clock::time_point now, bool force) {
+    if (!callback) return;
+
+    // Whoever finds a report due makes it; the others carry on searching.
+    std::unique_lock<std::mutex> ul(reporting, std::defer_lock);
+    if (force) {
+        ul.lock();
+    } else if (!ul.try_lock() || now < nextReport) {
+        return;
+    }
+    nextReport = now + interval;
+    callback(progress());
+}
+
+void SearchLimits::addSubtrees(uint64_t n) {
+    nSubtrees.fetch_add(n, std::memory_order_relaxed);
+}
+
+void SearchLimits::finishSubtree() {
+    nSubtreesDone.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool SearchLimits::check(uint64_t nVisited, uint64_t nFound) {
+    uint64_t visited =
+        this->nVisited.fetch_add(nVisited, std::memory_order_relaxed) +
+        nVisited;
+    this->nFound.fetch_add(nFound, std::memory_order_relaxed);
+
+    Clock::time_point now = Clock::now();
+    if (cancelled.load(std::memory_order_relaxed)) stop(kCancelled);
+    if (now >= deadline) stop(kDeadline);
+    if (budget != 0 && visited >= budget) stop(kBudget);
+
+    report(now, false);
+    return !stopped();
+}
+
+void SearchLimits::reportNow() {
+    report(Clock::now(), true);
+}
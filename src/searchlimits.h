@@ -0,0 +1,138 @@
+/*
+ * File: searchlimits.h
+ * Author: Jeremy Ephron
+ * ----------------------
+ * The interface for the SearchLimits class, which bounds how long a search
+ * may run and reports how far it has got: a deadline, a budget of word
+ * classes to visit, and a flag any thread can set to cancel the search.
+ *
+ * Limits are only checked when SearchOptions points to a SearchLimits. Each
+ * worker then counts down the word classes it visits, and every
+ * kCheckInterval of them, and whenever it finishes a task, adds what it did
+ * to the limits and checks them, so the loop of the search pays a decrement
+ * per class and the clock is only read once in a while. Once a limit is hit
+ * every task returns as soon as it next checks whether to stop, the
+ * solutions found so far are kept (and streamed) as usual, and outcome()
+ * tells why the search stopped.
+ *
+ * Given a callback, the progress of the search is passed to it at most once
+ * per interval, from the worker that checks the limits when it is due: the
+ * first words whose subtrees have been searched out of those to search, the
+ * solutions found and the classes visited so far.
+ *
+ * The limits of a SearchLimits carry over from one search to the next, so
+ * the several searches of a best query share one deadline and one budget;
+ * use a SearchLimits per request.
+ */
+
+#ifndef Search_Limits
+#define Search_Limits
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+
+class SearchLimits {
+public:  /* Interface */
+
+    using Clock = std::chrono::steady_clock;
+
+    // Why a search stopped: kFinished if it ran to the end (or to the limit
+    // of its query), otherwise the limit it hit first.
+    enum Outcome { kFinished, kCancelled, kDeadline, kBudget };
+
+    /* How far the searches using the limits have got. */
+    struct Progress {
+        uint64_t nSubtrees = 0;      // first words to search
+        uint64_t nSubtreesDone = 0;  // first words whose subtrees are done
+        uint64_t nFound = 0;         // solutions found (or counted)
+        uint64_t nVisited = 0;       // word classes visited
+    };
+
+    using ProgressCallback = std::function<void(const Progress &progress)>;
+
+    /** Sets no limits, so that a search only stops if cancelled. */
+    SearchLimits();
+
+    /**
+     * Cancels the searches using the limits. May be called from any thread,
+     * and from a signal handler.
+     */
+    void cancel();
+
+    /** Stops searching once deadline has passed. */
+    void setDeadline(Clock::time_point deadline);
+
+    /** Stops searching once timeout has passed from now. */
+    void setTimeout(Clock::duration timeout);
+
+    /** Stops searching after visiting about nClasses word classes. */
+    void setBudget(uint64_t nClasses);
+
+    /** Passes the progress of the search to callback every interval. */
+    void onProgress(ProgressCallback callback, Clock::duration interval);
+
+    /** Returns true once a limit has stopped a search. */
+    bool stopped() const;
+
+    /** Returns why the last search using the limits stopped. */
+    Outcome outcome() const;
+
+    /** Returns how far the searches have got, as of the last check. */
+    Progress progress() const;
+
+    /** Returns the name of an outcome, as the program prints it. */
+    static const char *outcomeName(Outcome outcome);
+
+private:
+
+    /** Stops the search for a reason, unless it was stopped already. */
+    void stop(Outcome reason);
+
+    /** Passes the progress to the callback if it is due, or if forced. */
+    void report(Clock::time_point now, bool force);
+
+    std::atomic<bool> cancelled;
+    std::atomic<int> stoppedBy;        // an Outcome
+    Clock::time_point deadline;        // Clock::time_point::max() for none
+    uint64_t budget;                   // 0 for no budget
+
+    std::atomic<uint64_t> nSubtrees;
+    std::atomic<uint64_t> nSubtreesDone;
+    std::atomic<uint64_t> nFound;
+    std::atomic<uint64_t> nVisited;
+
+    ProgressCallback callback;
+    Clock::duration interval;
+    std::mutex reporting;              // held while calling the callback
+    Clock::time_point nextReport;      // guarded by reporting
+
+public:  /* used by the search, not necessary for most users */
+
+    /** Counts subtrees the search is about to search. */
+    void addSubtrees(uint64_t n);
+
+    /** Counts a subtree searched to the end. */
+    void finishSubtree();
+
+    /**
+     * Adds the classes a worker visited and the solutions it found since its
+     * last check, and checks the limits.
+     *
+     * @returns false if the search must stop.
+     */
+    bool check(uint64_t nVisited, uint64_t nFound);
+
+    /** Passes the progress to the callback, if any, whether due or not. */
+    void reportNow();
+
+    // The classes a worker visits between two checks of the limits.
+    static const uint64_t kCheckInterval;
+
+    SearchLimits(const SearchLimits &) = delete;
+    SearchLimits &operator=(const SearchLimits &) = delete;
+};
+
+#endif
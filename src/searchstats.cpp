@@ -0,0 +1,111 @@
+/*
+ * File: searchstats.cpp
+ * Author: Jeremy Ephron
+ * ---------------------
+ * The implementation of the SearchStats class.
+ */
+
+#include "searchstats.h"
+#include <cctype>
+
+const char *const SearchStats::kPhaseNames[kNumPhases] = {
+    "load", "filter", "graph", "solve", "write"
+};
+
+/* Returns a duration in milliseconds. */
+static double millis(SearchStats::Duration time) {
+    return std::chrono::duration<double, std::milli>(time).count();
+}
+
+SearchStats::SearchStats()
+    : phases(), wordsStartingWith(), lockWait(0), nSearches(0) {}
+
+void SearchStats::addTime(Phase phase, Duration time) {
+    phases[phase] += time;
+}
+
+void SearchStats::countWords(const WordTable &wordsStartingWith) {
+    for (const Word &word : wordsStartingWith) {
+        int letter = toupper(static_cast<unsigned char>(word[0]));
+        if (letter >= 'A' && letter <= 'Z') {
+            this->wordsStartingWith[letter - 'A']++;
+        }
+    }
+}
+
+void SearchStats::addDepths(const std::vector<Depth> &depths) {
+    if (this->depths.size() < depths.size()) {
+        this->depths.resize(depths.size());
+    }
+    for (size_t i = 0; i < depths.size(); i++) {
+        this->depths[i].visited += depths[i].visited;
+        this->depths[i].pruned += depths[i].pruned;
+    }
+}
+
+void SearchStats::addBusyTime(size_t worker, Duration time) {
+    if (busy.size() <= worker) busy.resize(worker + 1, Duration(0));
+    busy[worker] += time;
+}
+
+void SearchStats::addLockWait(Duration time) {
+    lockWait += time;
+}
+
+void SearchStats::addSearch() {
+    nSearches++;
+}
+
+void SearchStats::printSummary(std::ostream &out) const {
+    out << "phases (ms):";
+    for (size_t i = 0; i < kNumPhases; i++) {
+        out << " " << kPhaseNames[i] << " " << millis(phases[i]);
+    }
+
+    out << "\nwords by first letter:";
+    for (size_t i = 0; i < 26; i++) {
+        if (wordsStartingWith[i] == 0) continue;
+        out << " " << char('A' + i) << " " << wordsStartingWith[i];
+    }
+
+    out << "\nsearches: " << nSearches;
+    for (size_t i = 0; i < depths.size(); i++) {
+        out << "\ndepth " << i << ": " << depths[i].visited << " visited, "
+            << depths[i].pruned << " pruned";
+    }
+
+    out << "\nbusy (ms):";
+    for (size_t i = 0; i < busy.size(); i++) {
+        out << " " << millis(busy[i]);
+    }
+    out << "\nlock wait (ms): " << millis(lockWait) << std::endl;
+}
+
+void SearchStats::writeJson(std::ostream &out) const {
+    out << "{\"phases_ms\": {";
+    for (size_t i = 0; i < kNumPhases; i++) {
+        out << (i == 0 ? "" : ", ") << "\"" << kPhaseNames[i] << "\": "
+            << millis(phases[i]);
+    }
+
+    out << "}, \"words_by_first_letter\": {";
+    bool first = true;
+    for (size_t i = 0; i < 26; i++) {
+        if (wordsStartingWith[i] == 0) continue;
+        out << (first ? "" : ", ") << "\"" << char('A' + i) << "\": "
+            << wordsStartingWith[i];
+        first = false;
+    }
+
+    out << "}, \"searches\": " << nSearches << ", \"depths\": [";
+    for (size_t i = 0; i < depths.size(); i++) {
+        out << (i == 0 ? "" : ", ") << "{\"visited\": " << depths[i].visited
+            << ", \"pruned\": " << depths[i].pruned << "}";
+    }
+
+    out << "], \"busy_ms\": [";
+    for (size_t i = 0; i < busy.size(); i++) {
+        out << (i == 0 ? "" : ", ") << millis(busy[i]);
+    }
+    out << "], \"lock_wait_ms\": " << millis(lockWait) << "}" << std::endl;
+}
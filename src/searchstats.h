@@ -0,0 +1,83 @@
+/*
+ * File: searchstats.h
+ * Author: Jeremy Ephron
+ * ---------------------
+ * The interface for the SearchStats class, the statistics a solve collects
+ * when asked to: the time of each phase, the words the filter kept for each
+ * starting letter, the word classes visited and pruned at each depth of the
+ * search, the time each worker spent searching and the time workers spent
+ * waiting for room in the solution stream.
+ *
+ * Statistics are only collected when SearchOptions points to a SearchStats,
+ * and the search otherwise pays a null check per word class it visits. Each
+ * worker counts into its own SearchState, and the counts are added to the
+ * SearchStats once the search is done, so a SearchStats is only ever used by
+ * one thread at a time. The statistics of several solves add up.
+ */
+
+#ifndef Search_Stats
+#define Search_Stats
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+#include "word.h"
+
+class SearchStats {
+public:  /* Interface */
+
+    using Duration = std::chrono::nanoseconds;
+
+    // The phases of a solve. kWrite is the time the writer thread spent
+    // formatting solutions, which overlaps kSolve.
+    enum Phase { kLoad, kFilter, kGraph, kSolve, kWrite, kNumPhases };
+
+    /* The word classes looked at by one depth of the search. */
+    struct Depth {
+        uint64_t visited = 0;  // classes tried as the word of this depth
+        uint64_t pruned = 0;   // classes that could not lead to a solution
+    };
+
+    SearchStats();
+
+    /** Adds the time taken by a phase. */
+    void addTime(Phase phase, Duration time);
+
+    /** Counts the filtered words of a puzzle by starting letter. */
+    void countWords(const WordTable &wordsStartingWith);
+
+    /** Adds the classes a worker visited and pruned at each depth. */
+    void addDepths(const std::vector<Depth> &depths);
+
+    /** Adds the time a worker spent running search tasks. */
+    void addBusyTime(size_t worker, Duration time);
+
+    /** Adds the time workers spent blocked waiting on a lock. */
+    void addLockWait(Duration time);
+
+    /** Counts a search, one per generateSolutions. */
+    void addSearch();
+
+    /** Writes a summary meant for people, a few lines long. */
+    void printSummary(std::ostream &out) const;
+
+    /** Writes every statistic as a single JSON object. */
+    void writeJson(std::ostream &out) const;
+
+private:
+
+    Duration phases[kNumPhases];
+    uint64_t wordsStartingWith[26];
+    std::vector<Depth> depths;
+    std::vector<Duration> busy;
+    Duration lockWait;
+    uint64_t nSearches;
+
+public:  /* public, but not necessary for most users */
+
+    // The names of the phases, as printed and in the JSON.
+    static const char *const kPhaseNames[kNumPhases];
+};
+
+#endif
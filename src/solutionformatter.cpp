@@ -0,0 +1,85 @@
+/*
+ * File: solutionformatter.cpp
+ * Author: Jeremy Ephron
+ * -------------------------
+ * The implementation of the SolutionFormatter class.
+ */
+
+#include "solutionformatter.h"
+
+const size_t SolutionFormatter::kBufferSize = 1 << 20;
+
+bool SolutionFormatter::parseFormat(const std::string &name, Format &format) {
+    if (name == "plain") format = kPlain;
+    else if (name == "csv") format = kCsv;
+    else if (name == "json") format = kJson;
+    else if (name == "binary") format = kBinary;
+    else return false;
+
+    return true;
+}
+
+SolutionFormatter::SolutionFormatter(std::ostream &out, Format format)
+    : out(out), format(format) {
+    buffer.reserve(kBufferSize + 1024);
+}
+
+SolutionFormatter::~SolutionFormatter() {
+    flush();
+}
+
+void SolutionFormatter::write(const SolutionSet &solutions) {
+    for (size_t i = 0; i < solutions.size(); i++) {
+        append(solutions[i], solutions.nWords);
+        if (buffer.size() >= kBufferSize) {
+            out.write(buffer.data(), buffer.size());
+            buffer.clear();
+        }
+    }
+}
+
+void SolutionFormatter::flush() {
+    out.write(buffer.data(), buffer.size());
+    buffer.clear();
+    out.flush();
+}
+
+void SolutionFormatter::append(const Word *const *solution,
+                               unsigned int nWords) {
+    switch (format) {
+        case kPlain:
+            for (unsigned int i = 0; i < nWords; i++) {
+                buffer.append(solution[i]->data(), solution[i]->size());
+                buffer += ' ';
+            }
+            buffer += '\n';
+            break;
+
+        case kCsv:
+            for (unsigned int i = 0; i < nWords; i++) {
+                if (i > 0) buffer += ',';
+                buffer.append(solution[i]->data(), solution[i]->size());
+            }
+            buffer += '\n';
+            break;
+
+        // Dictionary words are made only of 'A' to 'Z', so need no escaping.
+        case kJson:
+            buffer += '[';
+            for (unsigned int i = 0; i < nWords; i++) {
+                if (i > 0) buffer += ',';
+                buffer += '"';
+                buffer.append(solution[i]->data(), solution[i]->size());
+                buffer += '"';
+            }
+            buffer += "]\n";
+            break;
+
+        case kBinary:
+            for (unsigned int i = 0; i < nWords; i++) {
+                buffer.append(reinterpret_cast<const char *>(&solution[i]->id),
+                              sizeof(solution[i]->id));
+            }
+            break;
+    }
+}
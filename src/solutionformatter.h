@@ -0,0 +1,59 @@
+/*
+ * File: solutionformatter.h
+ * Author: Jeremy Ephron
+ * -------------------------
+ * The interface for the SolutionFormatter class, which formats solutions
+ * into a large reusable buffer and writes it to an output stream in big
+ * chunks.
+ *
+ * The supported formats are:
+ *   plain   the words of a solution separated by spaces, one per line
+ *   csv     the words of a solution separated by commas, one per line
+ *   json    a JSON array of the words of a solution per line
+ *   binary  the ids of the words (their positions in the DictionaryIndex)
+ *           as native-endian 32-bit integers, with no separators
+ */
+
+#ifndef Solution_Formatter
+#define Solution_Formatter
+
+#include <ostream>
+#include <string>
+#include "solutionset.h"
+
+class SolutionFormatter {
+public:  /* Interface */
+
+    enum Format { kPlain, kCsv, kJson, kBinary };
+
+    /** Sets format from its name, returning false if the name is unknown. */
+    static bool parseFormat(const std::string &name, Format &format);
+
+    SolutionFormatter(std::ostream &out, Format format = kPlain);
+
+    /** Formats every solution of a set, writing whenever the buffer fills. */
+    void write(const SolutionSet &solutions);
+
+    /** Writes out whatever is left in the buffer and flushes the stream. */
+    void flush();
+
+private:
+
+    /** Formats a single solution onto the end of the buffer. */
+    void append(const Word *const *solution, unsigned int nWords);
+
+    std::ostream &out;
+    Format format;
+    std::string buffer;
+
+public:  /* public, but not necessary for most users */
+
+    static const size_t kBufferSize;
+
+    ~SolutionFormatter();
+
+    SolutionFormatter(const SolutionFormatter &) = delete;
+    SolutionFormatter &operator=(const SolutionFormatter &) = delete;
+};
+
+#endif
@@ -0,0 +1,49 @@
+/*
+ * File: solutionset.h
+ * Author: Jeremy Ephron
+ * ---------------------
+ * Definition of the SolutionSet object, a compact list of solutions that all
+ * have the same number of words.
+ *
+ * The words of every solution are stored back to back as pointers to the
+ * Words of the filtered word table, so finding a solution copies no strings.
+ * The table must outlive the SolutionSet.
+ */
+
+#ifndef Solution_Set
+#define Solution_Set
+
+#include <vector>
+#include "word.h"
+
+struct SolutionSet {
+    unsigned int nWords;
+
+    // Solution i is words[i * nWords] to words[(i + 1) * nWords - 1].
+    std::vector<const Word *> words;
+
+    SolutionSet(unsigned int nWords = 0) : nWords(nWords) {}
+
+    size_t size() const { return nWords == 0 ? 0 : words.size() / nWords; }
+
+    bool empty() const { return words.empty(); }
+
+    /** Returns the nWords words of solution i. */
+    const Word *const *operator[](size_t i) const {
+        return &words[i * nWords];
+    }
+
+    /** Adds a solution, given as an array of nWords words. */
+    void add(const Word *const *solution) {
+        words.insert(words.end(), solution, solution + nWords);
+    }
+
+    /** Adds every solution of another set with the same number of words. */
+    void append(const SolutionSet &other) {
+        words.insert(words.end(), other.words.begin(), other.words.end());
+    }
+
+    void clear() { words.clear(); }
+};
+
+#endif
@@ -0,0 +1,203 @@
+/*
+ * File: solutionsorter.cpp
+ * Author: Jeremy Ephron
+ * ------------------------
+ * The implementation of the SolutionSorter class.
+ */
+
+#include "solutionsorter.h"
+#include <algorithm>
+#include <queue>
+#include "solutionstream.h"
+
+const size_t SolutionSorter::kDefaultMemory = size_t(256) << 20;
+
+SolutionSorter::SolutionSorter(const WordTable &words, const WordGraph &graph,
+                               unsigned int nWords, Dedupe dedupe,
+                               size_t memory)
+    : words(words), nWords(nWords), dedupe(dedupe),
+      width(dedupe == kSets ? 2 * nWords : nWords), keyWidth(nWords),
+      ranks(words.size()), classRanks(words.size()), failed(false) {
+    // A record takes its ranks, and its position while the chunk is sorted.
+    size_t recordSize = width * sizeof(uint32_t) + sizeof(size_t);
+    maxRecords = std::max<size_t>(memory / recordSize, 1);
+
+    std::vector<uint32_t> order(words.size());
+    for (uint32_t i = 0; i < order.size(); i++) order[i] = i;
+    std::sort(order.begin(), order.end(), [&](uint32_t lhs, uint32_t rhs) {
+        int compared = words[lhs].compare(words[rhs]);
+        return compared != 0 ? compared < 0 : words[lhs].id < words[rhs].id;
+    });
+    byRank.reserve(order.size());
+    for (uint32_t rank = 0; rank < order.size(); rank++) {
+        ranks[order[rank]] = rank;
+        classRanks[order[rank]] = rank;
+        byRank.push_back(&words[order[rank]]);
+    }
+
+    // The words of a class are sorted, so the first is the smallest.
+    for (const WordGraph::Node *node = graph.begin(); node != graph.end();
+         node++) {
+        const Word *const *members = graph.words(*node);
+        uint32_t first = ranks[members[0] - words.data()];
+        for (size_t i = 0; i < node->size(); i++) {
+            classRanks[members[i] - words.data()] = first;
+        }
+    }
+}
+
+SolutionSorter::~SolutionSorter() {
+    for (std::FILE *run : runs) std::fclose(run);
+}
+
+bool SolutionSorter::parseDedupe(const std::string &name, Dedupe &dedupe) {
+    if (name == "none") dedupe = kNone;
+    else if (name == "classes") dedupe = kClasses;
+    else if (name == "sets") dedupe = kSets;
+    else return false;
+
+    return true;
+}
+
+bool SolutionSorter::add(const SolutionSet &batch) {
+    if (failed) return false;
+
+    for (size_t i = 0; i < batch.size(); i++) {
+        const Word *const *solution = batch[i];
+        size_t start = chunk.size();
+        chunk.resize(start + width);
+
+        // The solution is the last nWords ranks, after its sorted set.
+        uint32_t *record = chunk.data() + start;
+        for (unsigned int j = 0; j < nWords; j++) {
+            size_t index = solution[j] - words.data();
+            record[width - nWords + j] = dedupe == kClasses
+                                         ? classRanks[index] : ranks[index];
+        }
+        if (dedupe == kSets) {
+            std::copy(record + nWords, record + width, record);
+            std::sort(record, record + nWords);
+        }
+        if (chunk.size() / width >= maxRecords && !spill()) return false;
+    }
+    return true;
+}
+
+size_t SolutionSorter::numRuns() const {
+    return runs.size();
+}
+
+bool SolutionSorter::sameKey(const uint32_t *lhs, const uint32_t *rhs) const {
+    return std::equal(lhs, lhs + keyWidth, rhs);
+}
+
+std::vector<size_t> SolutionSorter::sortChunk() const {
+    std::vector<size_t> order(chunk.size() / width);
+    for (size_t i = 0; i < order.size(); i++) order[i] = i * width;
+
+    const uint32_t *records = chunk.data();
+    std::sort(order.begin(), order.end(), [&](size_t lhs, size_t rhs) {
+        return std::lexicographical_compare(records + lhs,
+                                            records + lhs + width,
+                                            records + rhs,
+                                            records + rhs + width);
+    });
+    order.erase(std::unique(order.begin(), order.end(),
+                            [&](size_t lhs, size_t rhs) {
+                                return sameKey(records + lhs, records + rhs);
+                            }),
+                order.end());
+    return order;
+}
+
+bool SolutionSorter::spill() {
+    std::vector<size_t> order = sortChunk();
+    std::FILE *run = std::tmpfile();
+    if (run == nullptr) {
+        failed = true;
+        return false;
+    }
+    runs.push_back(run);
+
+    for (size_t position : order) {
+        if (std::fwrite(chunk.data() + position, sizeof(uint32_t), width,
+                        run) != width) {
+            failed = true;
+            return false;
+        }
+    }
+    if (std::fflush(run) != 0) {
+        failed = true;
+        return false;
+    }
+    chunk.clear();
+    return true;
+}
+
+void SolutionSorter::emit(const uint32_t *record, SolutionSet &batch,
+                          const Consumer &consume) const {
+    const uint32_t *solution = record + (width - nWords);
+    for (unsigned int i = 0; i < nWords; i++) {
+        batch.words.push_back(byRank[solution[i]]);
+    }
+    if (batch.size() >= SolutionStream::kBatchSize) {
+        consume(batch);
+        batch.clear();
+    }
+}
+
+uint64_t SolutionSorter::finish(const Consumer &consume) {
+    if (failed) return UINT64_MAX;
+
+    uint64_t nSolutions = 0;
+    SolutionSet batch(nWords);
+    if (runs.empty()) {
+        for (size_t position : sortChunk()) {
+            emit(chunk.data() + position, batch, consume);
+            nSolutions++;
+        }
+        chunk.clear();
+        if (!batch.empty()) consume(batch);
+        return nSolutions;
+    }
+    if (!chunk.empty() && !spill()) return UINT64_MAX;
+
+    // Merges the runs through a heap of the next record of each.
+    std::vector<uint32_t> heads(runs.size() * width);
+    auto read = [&](size_t run) {
+        return std::fread(heads.data() + run * width, sizeof(uint32_t), width,
+                          runs[run]) == width;
+    };
+    auto after = [&](size_t lhs, size_t rhs) {
+        const uint32_t *left = heads.data() + lhs * width;
+        const uint32_t *right = heads.data() + rhs * width;
+        return std::lexicographical_compare(right, right + width, left,
+                                            left + width);
+    };
+    std::priority_queue<size_t, std::vector<size_t>, decltype(after)>
+        queue(after);
+    for (size_t run = 0; run < runs.size(); run++) {
+        std::rewind(runs[run]);
+        if (read(run)) queue.push(run);
+    }
+
+    std::vector<uint32_t> last(width);
+    while (!queue.empty()) {
+        size_t run = queue.top();
+        queue.pop();
+        const uint32_t *record = heads.data() + run * width;
+        if (nSolutions == 0 || !sameKey(record, last.data())) {
+            std::copy(record, record + width, last.begin());
+            emit(record, batch, consume);
+            nSolutions++;
+        }
+        if (read(run)) queue.push(run);
+    }
+    if (!batch.empty()) consume(batch);
+
+    bool ok = true;
+    for (std::FILE *run : runs) ok = !std::ferror(run) && ok;
+    for (std::FILE *run : runs) std::fclose(run);
+    runs.clear();
+    return ok ? nSolutions : UINT64_MAX;
+}
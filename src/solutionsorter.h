@@ -0,0 +1,127 @@
+/*
+ * File: solutionsorter.h
+ * Author: Jeremy Ephron
+ * ----------------------
+ * The interface for the SolutionSorter class, which puts the solutions of a
+ * search in a canonical order, optionally dropping those equivalent to
+ * another, using a bounded amount of memory however many there are.
+ *
+ * The order is that of the words of a solution compared one by one, which
+ * is also the order of its lines in the plain format, so it does not depend
+ * on the threads of the search or on which of them found what first.
+ *
+ * Solutions can be deduplicated in two ways. Up to word classes, every word
+ * is replaced by the first word of its WordGraph class, which starts and
+ * ends with the same letters and uses the same ones, so the result is still
+ * a solution and two solutions are equivalent exactly when they become the
+ * same one. Up to word order, solutions are compared as sets of words, and
+ * the first of each set in canonical order is kept, in the order it was
+ * found in so that it can still be typed in; solutions then come ordered by
+ * their sets of words (each sorted), which is just as deterministic.
+ *
+ * Solutions are kept as fixed width records of word ranks (their positions
+ * among the words of the puzzle sorted alphabetically), a chunk at a time.
+ * Once a chunk fills the memory allowed, it is sorted, has its duplicates
+ * dropped and is written to a temporary file as a sorted run; finish()
+ * merges the runs, dropping the duplicates across them as it goes. A search
+ * whose solutions fit in memory never touches the disk.
+ */
+
+#ifndef Solution_Sorter
+#define Solution_Sorter
+
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+#include "solutionset.h"
+#include "word.h"
+#include "wordgraph.h"
+
+class SolutionSorter {
+public:  /* Interface */
+
+    // kNone keeps every solution, kClasses one per path of word classes and
+    // kSets one per set of words.
+    enum Dedupe { kNone, kClasses, kSets };
+
+    /** Takes each batch of sorted solutions in turn. */
+    using Consumer = std::function<void(const SolutionSet &batch)>;
+
+    /**
+     * Sorts solutions of nWords words of a graph built from words, keeping
+     * at most about memory bytes of them in memory.
+     */
+    SolutionSorter(const WordTable &words, const WordGraph &graph,
+                   unsigned int nWords, Dedupe dedupe = kNone,
+                   size_t memory = kDefaultMemory);
+
+    /**
+     * Adds a batch of solutions, sorting and writing out a run if the chunk
+     * is full.
+     *
+     * @returns false if a run could not be written.
+     */
+    bool add(const SolutionSet &batch);
+
+    /**
+     * Passes every solution added, sorted and deduplicated, to consume, in
+     * batches, and frees the runs.
+     *
+     * @returns the number of solutions passed, or UINT64_MAX if a run could
+     *          not be written or read back.
+     */
+    uint64_t finish(const Consumer &consume);
+
+    /** Returns the number of runs written to disk so far. */
+    size_t numRuns() const;
+
+    /** Sets dedupe from its name, returning false if the name is unknown. */
+    static bool parseDedupe(const std::string &name, Dedupe &dedupe);
+
+private:
+
+    /** Sorts the chunk, drops its duplicates and writes it out as a run. */
+    bool spill();
+
+    /**
+     * Sorts the records of the chunk, in memory.
+     *
+     * @returns the positions of the records in order, without duplicates.
+     */
+    std::vector<size_t> sortChunk() const;
+
+    /** Adds the solution of a record to batch, passing it on once full. */
+    void emit(const uint32_t *record, SolutionSet &batch,
+              const Consumer &consume) const;
+
+    /** Returns true if the keys of two records are equal. */
+    bool sameKey(const uint32_t *lhs, const uint32_t *rhs) const;
+
+    const WordTable &words;
+    unsigned int nWords;
+    Dedupe dedupe;
+    size_t width;                       // ranks per record
+    size_t keyWidth;                    // of which make up its key
+    size_t maxRecords;                  // per chunk
+
+    std::vector<uint32_t> ranks;        // of each word of the table, by index
+    std::vector<uint32_t> classRanks;   // of the first word of its class
+    std::vector<const Word *> byRank;
+
+    std::vector<uint32_t> chunk;        // width ranks per record
+    std::vector<std::FILE *> runs;
+    bool failed;
+
+public:  /* public, but not necessary for most users */
+
+    static const size_t kDefaultMemory;
+
+    ~SolutionSorter();
+
+    SolutionSorter(const SolutionSorter &) = delete;
+    SolutionSorter &operator=(const SolutionSorter &) = delete;
+};
+
+#endif
@@ -0,0 +1,109 @@
+/*
+ * File: solutionstream.cpp
+ * Author: Jeremy Ephron
+ * ----------------------
+ * The implementation of the SolutionStream class.
+ */
+
+#include "solutionstream.h"
+
+using Clock = std::chrono::steady_clock;
+
+const size_t SolutionStream::kBatchSize = 4096;
+const size_t SolutionStream::kDefaultCapacity = 64;
+const uint64_t SolutionStream::kNoTask = UINT64_MAX;
+
+SolutionStream::SolutionStream(std::ostream &out,
+                               SolutionFormatter::Format format,
+                               size_t capacity)
+    : formatter(new SolutionFormatter(out, format)), capacity(capacity),
+      closed(false), count(0), waited(0), written(0) {
+    SolutionFormatter *sink = formatter.get();
+    consumer = [sink](const SolutionSet &batch) { sink->write(batch); };
+    writer = std::thread(&SolutionStream::run, this);
+}
+
+SolutionStream::SolutionStream(Consumer consumer, size_t capacity)
+    : consumer(std::move(consumer)), capacity(capacity), closed(false),
+      count(0), waited(0), written(0) {
+    writer = std::thread(&SolutionStream::run, this);
+}
+
+SolutionStream::~SolutionStream() {
+    close();
+}
+
+void SolutionStream::push(SolutionSet &batch) {
+    push(batch, kNoTask, false);
+}
+
+void SolutionStream::push(SolutionSet &batch, uint64_t task, bool done) {
+    unsigned int nWords = batch.nWords;
+    count += batch.size();
+    auto start = Clock::now();
+    {
+        std::unique_lock<std::mutex> lk(lock);
+        notFull.wait(lk, [this] { return queue.size() < capacity; });
+        queue.push_back({std::move(batch), task, done});
+    }
+    waited += std::chrono::nanoseconds(Clock::now() - start).count();
+    notEmpty.notify_one();
+
+    batch = SolutionSet(nWords);
+}
+
+void SolutionStream::track(Tracker tracker) {
+    std::lock_guard<std::mutex> lg(lock);
+    this->tracker = std::move(tracker);
+}
+
+void SolutionStream::flushOutput() {
+    auto start = Clock::now();
+    if (formatter != nullptr) formatter->flush();
+    written += Clock::now() - start;
+}
+
+void SolutionStream::close() {
+    {
+        std::lock_guard<std::mutex> lg(lock);
+        if (closed) return;
+        closed = true;
+    }
+    notEmpty.notify_one();
+    writer.join();
+    flushOutput();
+}
+
+size_t SolutionStream::numSolutions() const {
+    return this->count;
+}
+
+std::chrono::nanoseconds SolutionStream::waitTime() const {
+    return std::chrono::nanoseconds(this->waited.load());
+}
+
+std::chrono::nanoseconds SolutionStream::writeTime() const {
+    return this->written;
+}
+
+void SolutionStream::run() {
+    while (true) {
+        Item item;
+        {
+            std::unique_lock<std::mutex> lk(lock);
+            notEmpty.wait(lk, [this] { return !queue.empty() || closed; });
+            if (queue.empty()) break;
+
+            item = std::move(queue.front());
+            queue.pop_front();
+        }
+        notFull.notify_one();
+
+        auto start = Clock::now();
+        if (!item.batch.empty()) consumer(item.batch);
+        written += Clock::now() - start;
+        if (item.task != kNoTask && tracker) {
+            tracker(item.task, item.batch.size(), item.done);
+        }
+    }
+}
@@ -0,0 +1,170 @@
+/*
+ * File: solutionstream.h
+ * Author: Jeremy Ephron
+ * ----------------------
+ * The interface for the SolutionStream class, which writes solutions to an
+ * output stream while the search is still running.
+ *
+ * Workers hand over batches of solutions through a bounded queue, blocking
+ * while it is full, and a writer thread passes them to a SolutionFormatter,
+ * or to a Consumer of the caller's. Memory use stays flat no matter how many
+ * solutions are found.
+ *
+ * A batch may be pushed as part of a task, for a Tracker to be told, on the
+ * writer thread and once the batch has been written, how many solutions of
+ * which task have been written and whether they were its last. A Checkpoint
+ * uses this to know exactly what the output holds.
+ */
+
+#ifndef Solution_Stream
+#define Solution_Stream
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include "solutionformatter.h"
+#include "solutionset.h"
+
+class SolutionStream {
+public:  /* Interface */
+
+    /** Takes each batch of solutions in turn, on the writer thread. */
+    using Consumer = std::function<void(const SolutionSet &batch)>;
+
+    /**
+     * Told that nSolutions more solutions of a task have been written, and
+     * whether the task is done, on the writer thread.
+     */
+    using Tracker = std::function<void(uint64_t task, size_t nSolutions,
+                                       bool done)>;
+
+    /** Starts a writer thread for an output stream. */
+    SolutionStream(std::ostream &out,
+                   SolutionFormatter::Format format = SolutionFormatter::kPlain,
+                   size_t capacity = kDefaultCapacity);
+
+    /** Starts a writer thread handing every batch to a consumer. */
+    SolutionStream(Consumer consumer, size_t capacity = kDefaultCapacity);
+
+    /**
+     * Queues every solution of a batch to be written, leaving the batch
+     * empty. Blocks while the queue is full.
+     */
+    void push(SolutionSet &batch);
+
+    /**
+     * Queues a batch of the solutions of a task, which may be empty, to be
+     * written and then passed on to the tracker, if there is one.
+     */
+    void push(SolutionSet &batch, uint64_t task, bool done);
+
+    /** Sets the tracker of pushed tasks. Must be set before pushing them. */
+    void track(Tracker tracker);
+
+    /**
+     * Writes out what the formatter holds and flushes the output stream, if
+     * writing to one. Only to be called on the writer thread, by a tracker,
+     * or once the stream is closed.
+     */
+    void flushOutput();
+
+    /** Waits until every queued solution has been written, then flushes. */
+    void close();
+
+    /** Returns the number of solutions pushed so far. */
+    size_t numSolutions() const;
+
+    /** Returns the time push() has spent waiting for the queue, in total. */
+    std::chrono::nanoseconds waitTime() const;
+
+    /**
+     * Returns the time the writer thread has spent writing solutions. Only
+     * up to date once the stream is closed.
+     */
+    std::chrono::nanoseconds writeTime() const;
+
+private:
+
+    /* A batch waiting to be written, and the task it is part of. */
+    struct Item {
+        SolutionSet batch;
+        uint64_t task;
+        bool done;
+    };
+
+    /** The loop run by the writer thread. */
+    void run();
+
+    std::unique_ptr<SolutionFormatter> formatter;  // when writing to a stream
+    Consumer consumer;
+    Tracker tracker;
+
+    std::mutex lock;
+    std::condition_variable notFull;
+    std::condition_variable notEmpty;
+    std::deque<Item> queue;
+    size_t capacity;
+    bool closed;
+
+    std::atomic<size_t> count;
+    std::atomic<int64_t> waited;       // nanoseconds spent blocked in push()
+    std::chrono::nanoseconds written;  // only touched by the writer
+    std::thread writer;
+
+public:  /* public, but not necessary for most users */
+
+    // The number of solutions a worker collects before pushing them.
+    static const size_t kBatchSize;
+
+    static const size_t kDefaultCapacity;
+
+    // The task of batches that are not part of one.
+    static const uint64_t kNoTask;
+
+    ~SolutionStream();
+
+    SolutionStream(const SolutionStream &) = delete;
+    SolutionStream &operator=(const SolutionStream &) = delete;
+};
+
+/**
+ * A worker's buffer of solutions. With a stream, the buffer is pushed to it
+ * whenever it holds a full batch; without one it keeps every solution.
+ */
+struct SolutionBuffer {
+    SolutionSet solutions;
+    SolutionStream *stream;
+    uint64_t task = SolutionStream::kNoTask;  // the task solutions are of
+
+    SolutionBuffer(unsigned int nWords, SolutionStream *stream = nullptr)
+        : solutions(nWords), stream(stream) {}
+
+    void add(const Word *const *solution) {
+        solutions.add(solution);
+        if (stream && solutions.size() >= SolutionStream::kBatchSize) {
+            stream->push(solutions, task, false);
+        }
+    }
+
+    /** Pushes any remaining solutions to the stream, if there is one. */
+    void flush() {
+        if (stream && !solutions.empty()) stream->push(solutions, task, false);
+    }
+
+    /**
+     * Pushes the rest of the solutions of the task, even if there are none,
+     * telling the stream whether the task is done.
+     */
+    void finish(bool done) {
+        if (stream) stream->push(solutions, task, done);
+    }
+};
+
+#endif
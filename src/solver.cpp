@@ -0,0 +1,78 @@
+/*
+ * File: solver.cpp
+ * Author: Jeremy Ephron
+ * ------------------
+ * The implementation of the Solver class.
+ */
+
+#include "solver.h"
+#include "letterbox.h"
+#include "solutionset.h"
+#include "solutionstream.h"
+#include "wordgraph.h"
+
+Solver::Solver(const std::string &dictionary, size_t nThreads,
+               size_t cacheCapacity, const std::string &cacheDirectory)
+    : dictionary(dictionary), pool(nThreads) {
+    if (this->dictionary.isOpen() &&
+        (cacheCapacity != 0 || !cacheDirectory.empty())) {
+        cache.reset(new PuzzleCache(this->dictionary, cacheCapacity,
+                                    cacheDirectory));
+    }
+}
+
+bool Solver::isOpen() const {
+    return this->dictionary.isOpen();
+}
+
+bool Solver::solve(const std::string &letters, unsigned int nWords,
+                   const SearchOptions &options, const Callback &callback,
+                   uint64_t &nFound, std::string &error) {
+    if (!dictionary.isOpen()) {
+        error = "no dictionary loaded";
+        return false;
+    }
+
+    std::string puzzle = letters;
+    if (!checkPuzzle(puzzle, nWords, error)) return false;
+
+    auto consumer = [&callback](const SolutionSet &batch) {
+        for (size_t i = 0; i < batch.size(); i++) {
+            callback(batch[i], batch.nWords);
+        }
+    };
+    if (cache != nullptr) {
+        nFound = cache->solve(puzzle, nWords, options, pool, consumer);
+        return true;
+    }
+
+    LetterBox letterBox(puzzle);
+    WordTable wordsStartingWith;
+    buildFilteredWordList(dictionary, letterBox, wordsStartingWith);
+    WordGraph graph(letterBox, wordsStartingWith);
+
+    SolutionStream stream(consumer);
+    nFound = solvePuzzle(graph, nWords, options, pool, &stream);
+    stream.close();
+    return true;
+}
+
+bool Solver::solve(const std::string &letters, unsigned int nWords,
+                   const SearchOptions &options,
+                   std::vector<std::vector<std::string> > &solutions,
+                   std::string &error) {
+    solutions.clear();
+    uint64_t nFound;
+    return solve(letters, nWords, options,
+                 [&solutions](const Word *const *solution,
+                              unsigned int nWords) {
+                     solutions.emplace_back();
+                     for (unsigned int i = 0; i < nWords; i++) {
+                         solutions.back().push_back(solution[i]->str());
+                     }
+                 }, nFound, error);
+}
+
+size_t Solver::numThreads() const {
+    return this->pool.numThreads();
+}
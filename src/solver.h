@@ -0,0 +1,101 @@
+/*
+ * File: solver.h
+ * Author: Jeremy Ephron
+ * ------------------
+ * The interface for the Solver class, the entry point of libletterboxed for
+ * programs that solve puzzles in process rather than through the command
+ * line program.
+ *
+ * A Solver loads a dictionary and starts a pool of workers once, and every
+ * puzzle it solves shares them. solve() may be called by several threads at
+ * once: the dictionary is read only, and each call runs its search as a
+ * TaskPool::Group of its own, so it waits only for its own tasks.
+ *
+ * Given a cache capacity or directory, puzzles and their results are kept in
+ * a PuzzleCache, and a query that was answered before is not solved again.
+ *
+ *     Solver solver("dictionary.idx");
+ *     uint64_t nFound;
+ *     std::string error;
+ *     solver.solve("GIYHCTLAOPRE", 2, SearchOptions(),
+ *                  [](const Word *const *solution, unsigned int nWords) {
+ *                      ...
+ *                  }, nFound, error);
+ */
+
+#ifndef Letter_Boxed_Solver
+#define Letter_Boxed_Solver
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "dictionaryindex.h"
+#include "puzzlecache.h"
+#include "search.h"
+#include "taskpool.h"
+#include "word.h"
+
+class Solver {
+public:  /* Interface */
+
+    /**
+     * Takes each solution of a puzzle, as its nWords words in order. The
+     * callback of a solve is called by one thread at a time, not necessarily
+     * the thread that called solve(), and the words are only valid during
+     * the call.
+     */
+    using Callback = std::function<void(const Word *const *solution,
+                                        unsigned int nWords)>;
+
+    /**
+     * Loads a dictionary (text or index) and starts nThreads workers, or one
+     * per hardware thread if nThreads is 0. Results are cached when either
+     * cacheCapacity or cacheDirectory is given, see PuzzleCache. Check
+     * isOpen() before solving.
+     */
+    Solver(const std::string &dictionary, size_t nThreads = 0,
+           size_t cacheCapacity = 0, const std::string &cacheDirectory = "");
+
+    /** Returns true if the dictionary was loaded. */
+    bool isOpen() const;
+
+    /**
+     * Solves a puzzle, passing every solution the query of options asks for
+     * to callback as it is found. Returns once the search is done, with the
+     * number of solutions found (or counted) in nFound, or false with the
+     * problem in error if the puzzle is invalid. options.stats, if set, must
+     * not be shared with another call running at the same time.
+     * options.limits, if set, bounds the search, and cancelling them from
+     * another thread makes solve() return with the solutions found so far.
+     */
+    bool solve(const std::string &letters, unsigned int nWords,
+               const SearchOptions &options, const Callback &callback,
+               uint64_t &nFound, std::string &error);
+
+    /**
+     * Solves a puzzle, collecting the words of every solution the query of
+     * options asks for. A count query leaves solutions empty.
+     */
+    bool solve(const std::string &letters, unsigned int nWords,
+               const SearchOptions &options,
+               std::vector<std::vector<std::string> > &solutions,
+               std::string &error);
+
+    /** Returns the number of worker threads. */
+    size_t numThreads() const;
+
+private:
+
+    DictionaryIndex dictionary;
+    TaskPool pool;
+    std::unique_ptr<PuzzleCache> cache;  // nullptr unless caching
+
+public:  /* public, but not necessary for most users */
+
+    Solver(const Solver &) = delete;
+    Solver &operator=(const Solver &) = delete;
+};
+
+#endif
@@ -0,0 +1,53 @@
+/*
+ * File: supersetindex.cpp
+ * Author: Jeremy Ephron
+ * ------------------------
+ * The implementation of the SupersetIndex class.
+ */
+
+#include "supersetindex.h"
+
+#include <algorithm>
+
+const size_t SupersetIndex::kMaxDenseLetters = 14;
+
+SupersetIndex::SupersetIndex(const WordGraph &graph)
+    : bucketOffsets(graph.numLetters() + 1, 0),
+      numLetters(graph.numLetters()), full(graph.fullMask()) {
+    if (numLetters <= kMaxDenseLetters) {
+        dense.assign(numLetters << numLetters, 0);
+    }
+
+    for (size_t first = 0; first < numLetters; first++) {
+        bucketOffsets[first] = buckets.size();
+
+        std::vector<const WordGraph::Node *> group;
+        for (auto node = graph.begin(first); node != graph.end(first); node++) {
+            group.push_back(node);
+        }
+        std::stable_sort(group.begin(), group.end(),
+                         [](const WordGraph::Node *lhs,
+                            const WordGraph::Node *rhs) {
+            return lhs->mask < rhs->mask;
+        });
+
+        for (const WordGraph::Node *node : group) {
+            if (buckets.size() == bucketOffsets[first] ||
+                buckets.back().mask != node->mask) {
+                Bucket bucket;
+                bucket.mask = node->mask;
+                bucket.begin = nodes.size();
+                bucket.end = nodes.size();
+                buckets.push_back(bucket);
+
+                if (!dense.empty()) {
+                    dense[(first << numLetters) | node->mask] = buckets.size();
+                }
+            }
+
+            nodes.push_back(node);
+            buckets.back().end = nodes.size();
+        }
+    }
+    bucketOffsets[numLetters] = buckets.size();
+}
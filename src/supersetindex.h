@@ -0,0 +1,92 @@
+/*
+ * File: supersetindex.h
+ * Author: Jeremy Ephron
+ * ------------------------
+ * The interface for the SupersetIndex class, which finds the words of a
+ * WordGraph that start with a given letter and cover a given set of letters.
+ *
+ * The words starting with each letter are bucketed by their letter mask. A
+ * query either scans the buckets of its first letter, or, for small boxes,
+ * enumerates the supersets of the wanted mask and looks each one up in a
+ * dense table, whichever touches fewer entries. Either way words with the
+ * same mask are matched (or skipped) together.
+ */
+
+#ifndef Superset_Index
+#define Superset_Index
+
+#include <cstdint>
+#include <vector>
+#include "letterbox.h"
+#include "wordgraph.h"
+
+class SupersetIndex {
+public:  /* Interface */
+
+    /** The words starting with one letter that share a mask. */
+    struct Bucket {
+        LetterMask mask;
+        uint32_t begin;     // range of nodes() holding the words
+        uint32_t end;
+    };
+
+    SupersetIndex(const WordGraph &graph);
+
+    /**
+     * Calls visit(node) for every word starting with the letter index first
+     * whose mask contains every letter of required.
+     */
+    template <typename Visitor>
+    void forEachSuperset(size_t first, LetterMask required,
+                         Visitor visit) const;
+
+private:
+
+    /** Calls visit(node) for every word of a bucket. */
+    template <typename Visitor>
+    void visitBucket(const Bucket &bucket, Visitor &visit) const;
+
+    std::vector<const WordGraph::Node *> nodes;
+    std::vector<Bucket> buckets;
+    std::vector<uint32_t> bucketOffsets;
+
+    // For boxes of at most kMaxDenseLetters letters, dense[first << n | mask]
+    // is one more than the index of the bucket with that mask, or 0.
+    std::vector<uint32_t> dense;
+    size_t numLetters;
+    LetterMask full;
+
+public:  /* public, but not necessary for most users */
+
+    static const size_t kMaxDenseLetters;
+};
+
+template <typename Visitor>
+void SupersetIndex::visitBucket(const Bucket &bucket, Visitor &visit) const {
+    for (uint32_t i = bucket.begin; i < bucket.end; i++) visit(nodes[i]);
+}
+
+template <typename Visitor>
+void SupersetIndex::forEachSuperset(size_t first, LetterMask required,
+                                    Visitor visit) const {
+    const Bucket *begin = buckets.data() + bucketOffsets[first];
+    const Bucket *end = buckets.data() + bucketOffsets[first + 1];
+
+    LetterMask free = full & ~required;
+    size_t nFree = __builtin_popcount(free);
+    if (!dense.empty() && (size_t(1) << nFree) < size_t(end - begin)) {
+        const uint32_t *table = dense.data() + (first << numLetters);
+        for (LetterMask extra = free; ; extra = (extra - 1) & free) {
+            uint32_t id = table[required | extra];
+            if (id != 0) visitBucket(buckets[id - 1], visit);
+            if (extra == 0) break;
+        }
+        return;
+    }
+
+    for (const Bucket *bucket = begin; bucket != end; bucket++) {
+        if ((required & ~bucket->mask) == 0) visitBucket(*bucket, visit);
+    }
+}
+
+#endif
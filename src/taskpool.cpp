@@ -0,0 +1,122 @@
+/*
+ * File: taskpool.cpp
+ * Author: Jeremy Ephron
+ * --------------------
+ * The implementation of the TaskPool class.
+ */
+
+#include "taskpool.h"
+
+// The pool and index of the worker the current thread is, if any, and the
+// group of the task it is running.
+static thread_local const TaskPool *currentPool = nullptr;
+static thread_local size_t currentIndex = 0;
+static thread_local TaskPool::Group *currentGroup = nullptr;
+
+TaskPool::TaskPool(size_t nThreads)
+    : queued(0), nextQueue(0), stopping(false) {
+    if (nThreads == 0) nThreads = std::thread::hardware_concurrency();
+    if (nThreads == 0) nThreads = 1;
+
+    for (size_t i = 0; i < nThreads; i++) {
+        queues.emplace_back(new Queue);
+    }
+    for (size_t i = 0; i < nThreads; i++) {
+        workers.emplace_back(&TaskPool::run, this, i);
+    }
+}
+
+TaskPool::~TaskPool() {
+    {
+        std::lock_guard<std::mutex> lg(lock);
+        stopping = true;
+    }
+    workAvailable.notify_all();
+    for (std::thread &t : workers) t.join();
+}
+
+void TaskPool::submit(Task task) {
+    bool inTask = currentPool == this && currentGroup != nullptr;
+    submit(std::move(task), inTask ? *currentGroup : ungrouped);
+}
+
+void TaskPool::submit(Task task, Group &group) {
+    size_t index = currentPool == this
+                   ? currentIndex
+                   : nextQueue++ % queues.size();
+
+    group.pending++;
+    {
+        std::lock_guard<std::mutex> lg(queues[index]->lock);
+        queues[index]->tasks.push_front({std::move(task), &group});
+    }
+    queued++;
+
+    // Taking the lock orders this wakeup after a worker's last empty check.
+    { std::lock_guard<std::mutex> lg(lock); }
+    workAvailable.notify_one();
+}
+
+void TaskPool::wait() {
+    wait(ungrouped);
+}
+
+void TaskPool::wait(Group &group) {
+    std::unique_lock<std::mutex> lk(lock);
+    allDone.wait(lk, [&group] { return group.pending == 0; });
+}
+
+size_t TaskPool::numThreads() const {
+    return this->workers.size();
+}
+
+size_t TaskPool::workerIndex() {
+    return currentIndex;
+}
+
+bool TaskPool::take(size_t index, Item &item) {
+    for (size_t i = 0; i < queues.size(); i++) {
+        Queue &queue = *queues[(index + i) % queues.size()];
+        std::lock_guard<std::mutex> lg(queue.lock);
+        if (queue.tasks.empty()) continue;
+
+        if (i == 0) {
+            item = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+        } else {
+            item = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        }
+        queued--;
+        return true;
+    }
+
+    return false;
+}
+
+void TaskPool::run(size_t index) {
+    currentPool = this;
+    currentIndex = index;
+
+    while (true) {
+        Item item;
+        if (take(index, item)) {
+            currentGroup = item.group;
+            item.task();
+            item.task = nullptr;
+            currentGroup = nullptr;
+
+            // The group (and whatever the task used) may be gone as soon as
+            // its last task is counted.
+            if (--item.group->pending == 0) {
+                { std::lock_guard<std::mutex> lg(lock); }
+                allDone.notify_all();
+            }
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lk(lock);
+        workAvailable.wait(lk, [this] { return queued > 0 || stopping; });
+        if (stopping && queued == 0) return;
+    }
+}
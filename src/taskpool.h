@@ -0,0 +1,125 @@
+/*
+ * File: taskpool.h
+ * Author: Jeremy Ephron
+ * --------------------
+ * The interface for the TaskPool class, a fixed-size pool of worker threads
+ * that run submitted tasks.
+ *
+ * Each worker has its own queue of tasks. Tasks submitted from inside a task
+ * go to the front of the submitting worker's queue, so a worker keeps working
+ * on the subtree it just split up, and idle workers steal the oldest (and
+ * so usually largest) tasks from the back of other workers' queues.
+ *
+ * Tasks can be submitted as part of a Group, and waited for by group, so
+ * that several threads can share a pool, each waiting only for its tasks.
+ */
+
+#ifndef Task_Pool
+#define Task_Pool
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class TaskPool {
+public:  /* Interface */
+
+    using Task = std::function<void()>;
+
+    /**
+     * A set of tasks that can be waited for on its own. A group must outlive
+     * the tasks submitted as part of it, which wait(group) makes sure of.
+     */
+    class Group {
+    public:
+        Group() : pending(0) {}
+
+    private:
+        friend class TaskPool;
+        std::atomic<size_t> pending;  // tasks submitted but not finished
+    };
+
+    /**
+     * Starts a pool of nThreads workers, or one per hardware thread if
+     * nThreads is 0.
+     */
+    TaskPool(size_t nThreads = 0);
+
+    /**
+     * Schedules a task to be run by one of the workers. A task submitted from
+     * inside a task is part of the same group as the task submitting it.
+     */
+    void submit(Task task);
+
+    /** Schedules a task to be run by one of the workers, as part of group. */
+    void submit(Task task, Group &group);
+
+    /**
+     * Blocks until every task submitted without a group, including tasks
+     * submitted by those tasks, has finished. Must not be called from inside
+     * a task.
+     */
+    void wait();
+
+    /**
+     * Blocks until every task of a group, including tasks submitted by those
+     * tasks, has finished. Must not be called from inside a task, but may be
+     * called by several threads at once, each for a group of its own.
+     */
+    void wait(Group &group);
+
+    /** Returns the number of worker threads. */
+    size_t numThreads() const;
+
+    /**
+     * Returns the index (0 to numThreads() - 1) of the worker running the
+     * calling task. Only meaningful when called from inside a task.
+     */
+    static size_t workerIndex();
+
+private:
+
+    /* A task and the group it is part of. */
+    struct Item {
+        Task task;
+        Group *group;
+    };
+
+    struct Queue {
+        std::mutex lock;
+        std::deque<Item> tasks;
+    };
+
+    /** The loop run by a worker thread. */
+    void run(size_t index);
+
+    /** Takes a task from the worker's own queue, or steals one. */
+    bool take(size_t index, Item &item);
+
+    std::vector<std::unique_ptr<Queue> > queues;
+    std::vector<std::thread> workers;
+
+    // Guards sleeping and waking workers and waiters.
+    std::mutex lock;
+    std::condition_variable workAvailable;
+    std::condition_variable allDone;
+
+    std::atomic<size_t> queued;    // tasks sitting in a queue
+    Group ungrouped;               // tasks submitted without a group
+    std::atomic<size_t> nextQueue; // round robin for outside submissions
+    bool stopping;
+
+public:  /* public, but not necessary for most users */
+
+    ~TaskPool();
+
+    TaskPool(const TaskPool &) = delete;
+    TaskPool &operator=(const TaskPool &) = delete;
+};
+
+#endif
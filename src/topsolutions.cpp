@@ -0,0 +1,75 @@
+/*
+ * File: topsolutions.cpp
+ * Author: Jeremy Ephron
+ * ----------------------
+ * The implementation of the TopSolutions class.
+ */
+
+#include "topsolutions.h"
+
+#include <algorithm>
+#include <climits>
+
+TopSolutions::TopSolutions(unsigned int nWords, size_t capacity)
+    : capacity(capacity), kept(nWords),
+      bound(capacity == 0 ? 0 : UINT_MAX) {}
+
+void TopSolutions::offer(const Word *const *solution, unsigned int length) {
+    if (!canImprove(length) || capacity == 0) return;
+
+    auto ranksFirst = [this](const Entry &lhs, const Entry &rhs) {
+        return ranksBefore(lhs.length, kept[lhs.slot], rhs);
+    };
+
+    std::lock_guard<std::mutex> guard(lock);
+    if (heap.size() < capacity) {
+        heap.push_back({length, heap.size()});
+        kept.add(solution);
+        std::push_heap(heap.begin(), heap.end(), ranksFirst);
+    } else if (ranksBefore(length, solution, heap.front())) {
+        std::pop_heap(heap.begin(), heap.end(), ranksFirst);
+        Entry &replaced = heap.back();
+        replaced.length = length;
+        std::copy(solution, solution + kept.nWords,
+                  kept.words.begin() + replaced.slot * kept.nWords);
+        std::push_heap(heap.begin(), heap.end(), ranksFirst);
+    } else {
+        return;
+    }
+
+    if (heap.size() == capacity) {
+        bound.store(heap.front().length, std::memory_order_relaxed);
+    }
+}
+
+size_t TopSolutions::size() const {
+    std::lock_guard<std::mutex> guard(lock);
+    return heap.size();
+}
+
+SolutionSet TopSolutions::sorted() const {
+    std::lock_guard<std::mutex> guard(lock);
+
+    std::vector<Entry> order = heap;
+    std::sort(order.begin(), order.end(),
+              [this](const Entry &lhs, const Entry &rhs) {
+        return ranksBefore(lhs.length, kept[lhs.slot], rhs);
+    });
+
+    SolutionSet solutions(kept.nWords);
+    for (const Entry &entry : order) solutions.add(kept[entry.slot]);
+    return solutions;
+}
+
+bool TopSolutions::ranksBefore(unsigned int length,
+                               const Word *const *solution,
+                               const Entry &e) const {
+    if (length != e.length) return length < e.length;
+
+    const Word *const *other = kept[e.slot];
+    for (unsigned int i = 0; i < kept.nWords; i++) {
+        int order = solution[i]->compare(*other[i]);
+        if (order != 0) return order < 0;
+    }
+    return false;
+}
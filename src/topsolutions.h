@@ -0,0 +1,67 @@
+/*
+ * File: topsolutions.h
+ * Author: Jeremy Ephron
+ * --------------------
+ * The interface for the TopSolutions class, which keeps the best solutions
+ * offered to it by any number of search threads.
+ *
+ * Solutions rank by their total number of letters, shortest first, and ties
+ * are broken by comparing their words in order, so the solutions kept never
+ * depend on the order they were offered in. The kept solutions form a heap
+ * with the worst one on top, and its length is published as the bound a
+ * partial solution must not exceed to still be worth extending, which the
+ * search reads without taking the lock.
+ */
+
+#ifndef Top_Solutions
+#define Top_Solutions
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include "solutionset.h"
+#include "word.h"
+
+class TopSolutions {
+public:  /* Interface */
+
+    /** Keeps the capacity best solutions of nWords words. */
+    TopSolutions(unsigned int nWords, size_t capacity);
+
+    /**
+     * Returns whether a solution (or a partial solution) of a given total
+     * length could still rank among the best.
+     */
+    bool canImprove(unsigned int length) const {
+        return length <= bound.load(std::memory_order_relaxed);
+    }
+
+    /** Keeps a solution if it ranks among the best offered so far. */
+    void offer(const Word *const *solution, unsigned int length);
+
+    /** Returns the number of solutions kept. */
+    size_t size() const;
+
+    /** Returns the solutions kept, best first. */
+    SolutionSet sorted() const;
+
+private:
+
+    /** A kept solution: its length and where its words are in kept. */
+    struct Entry {
+        unsigned int length;
+        size_t slot;
+    };
+
+    /** Whether a solution given by its length and words ranks before e. */
+    bool ranksBefore(unsigned int length, const Word *const *solution,
+                     const Entry &e) const;
+
+    size_t capacity;
+    std::vector<Entry> heap;    // the worst kept solution is heap.front()
+    SolutionSet kept;
+    std::atomic<unsigned int> bound;
+    mutable std::mutex lock;
+};
+
+#endif
@@ -2,69 +2,101 @@
  * File: word.h
  * Author: Jeremy Ephron
  * ---------------------
- * Definition of the Word object, which simply wraps a string together with the
- * number of unique letters the string contains.
+ * Definition of the Word object, which refers to the text of a word together
+ * with the mask of the LetterBox letters it covers and its id (its position
+ * in the DictionaryIndex).
+ *
+ * A Word does not own its text: it points into the text blob of the
+ * DictionaryIndex it was filtered from, which holds every word back to back
+ * and must outlive it. The words of a puzzle are kept in a single WordTable
+ * array, so filtering a puzzle allocates nothing per word and its words are
+ * released all at once.
  */
 
 #ifndef Word_
 #define Word_
 
+#include <algorithm>
+#include <cstring>
 #include <iostream>
 #include <string>
-#include <unordered_set>
+#include <vector>
+#include "letterbox.h"
 
 struct Word {
-    std::string content;
-    size_t nUniqueLetters;
+    const char *text;
+    uint32_t length;
+    LetterMask mask;
+    uint32_t id;
 
-    Word(const std::string &word) : content(word) {
-        std::unordered_set<char> letters;
-        for (char ch : word) letters.insert(ch);
-        nUniqueLetters = letters.size();
-    }
+    Word(const char *text, size_t length, LetterMask mask, uint32_t id = 0)
+        : text(text), length(length), mask(mask), id(id) {}
 
-    size_t size() const { return content.size(); }
+    size_t size() const { return length; }
 
-    friend bool operator==(const Word &lhs, const Word &rhs) {
-        return lhs.content == rhs.content;
-    }
+    const char *data() const { return text; }
 
-    friend bool operator<(const Word &lhs, const Word &rhs) {
-        return lhs.content < rhs.content;
+    char back() const { return text[length - 1]; }
+
+    /** Returns the number of unique Letter Box letters in the word. */
+    size_t nUniqueLetters() const { return __builtin_popcount(mask); }
+
+    /** Returns the text of the word as a string. */
+    std::string str() const { return std::string(text, length); }
+
+    /** Compares the text of two words like std::string::compare. */
+    int compare(const Word &other) const {
+        int order = std::memcmp(text, other.text,
+                                std::min(length, other.length));
+        if (order != 0) return order;
+        return length < other.length ? -1 : length > other.length ? 1 : 0;
     }
 
-    friend bool operator<(const Word &lhs, const std::string &rhs) {
-        return lhs.content < rhs;
+    friend bool operator==(const Word &lhs, const Word &rhs) {
+        return lhs.compare(rhs) == 0;
     }
 
-    friend bool operator<(const std::string &lhs, const Word &rhs) {
-        return lhs < rhs.content;
+    friend bool operator<(const Word &lhs, const Word &rhs) {
+        return lhs.compare(rhs) < 0;
     }
 
     friend std::ostream& operator<<(std::ostream &out, const Word &word) {
-        return out << word.content;
+        return out.write(word.text, word.length);
     }
 
-    char operator[](int index) const {
-        if (index < 0 || index >= this->content.length()) {
+    char operator[](size_t index) const {
+        if (index >= this->length) {
             std::cout << "Word index out of bounds, exiting." << std::endl;
             exit(0);
         }
 
-        return this->content[index];
+        return this->text[index];
     }
 };
 
 namespace std {
     template <>
-    struct std::hash<Word> {
+    struct hash<Word> {
         typedef Word argument_type;
         typedef std::size_t result_type;
 
+        /* FNV-1a over the text of the word. */
         result_type operator()(const argument_type &word) const {
-            return std::hash<std::string>()(word.content);
+            uint64_t hash = 14695981039346656037ULL;
+            for (uint32_t i = 0; i < word.length; i++) {
+                hash = (hash ^ static_cast<unsigned char>(word.text[i])) *
+                       1099511628211ULL;
+            }
+            return hash;
         }
     };
 }
 
+/*
+ * The filtered words of a puzzle, grouped by starting character in the order
+ * of the letters of the box. The array must not grow once Words are
+ * referred to.
+ */
+using WordTable = std::vector<Word>;
+
 #endif
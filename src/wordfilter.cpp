@@ -0,0 +1,252 @@
+/*
+ * File: wordfilter.cpp
+ * Author: Jeremy Ephron
+ * -----------------------
+ * The implementation of the WordFilter class.
+ */
+
+#include "wordfilter.h"
+
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define WORD_FILTER_X86
+#endif
+
+using Entry = DictionaryIndex::Entry;
+
+/* The longest word the vector kernels check without falling back. */
+static const size_t kMaxVectorLength = 16;
+
+WordFilter::WordFilter(const LetterBox &letterBox)
+    : WordFilter(letterBox, bestKernel()) {}
+
+WordFilter::WordFilter(const LetterBox &letterBox, Kernel kernel)
+    : letterBox(letterBox), kernelUsed(std::min(kernel, bestKernel())),
+      alphabet(letterBox.alphabetMask()) {
+    for (size_t i = 0; i < sizeof(walls); i++) {
+        walls[i] = i < 26 ? letterBox.wallIndex('A' + i) : LetterBox::kNone;
+    }
+}
+
+WordFilter::Kernel WordFilter::kernel() const {
+    return this->kernelUsed;
+}
+
+WordFilter::Kernel WordFilter::bestKernel() {
+#ifdef WORD_FILTER_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return kAvx2;
+    if (__builtin_cpu_supports("sse4.2")) return kSse42;
+#endif
+    return kScalar;
+}
+
+/* Appends the words of [begin, end) that pass, one word at a time. */
+static void filterScalar(const DictionaryIndex &dictionary,
+                         const LetterBox &letterBox, uint32_t alphabet,
+                         const Entry *begin, const Entry *end,
+                         std::vector<const Entry *> &matches) {
+    const uint32_t *masks = dictionary.alphabetMasks();
+    for (const Entry *entry = begin; entry != end; entry++) {
+        if ((masks[dictionary.id(*entry)] & ~alphabet) != 0) continue;
+        if (letterBox.canMakeWord(dictionary.text(*entry), entry->length)) {
+            matches.push_back(entry);
+        }
+    }
+}
+
+#ifdef WORD_FILTER_X86
+
+/*
+ * Translates 16 letters of text to the walls they are on: a shuffle looks
+ * 'A' to 'P' up in lowWalls and 'Q' to 'Z' in highWalls.
+ */
+__attribute__((target("sse4.2")))
+static inline __m128i toWalls(__m128i lowWalls, __m128i highWalls,
+                              const char *text) {
+    __m128i index = _mm_sub_epi8(
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(text)),
+        _mm_set1_epi8('A'));
+    __m128i low = _mm_shuffle_epi8(lowWalls, index);
+    __m128i high = _mm_shuffle_epi8(highWalls,
+                                    _mm_sub_epi8(index, _mm_set1_epi8(16)));
+    return _mm_blendv_epi8(low, high,
+                           _mm_cmpgt_epi8(index, _mm_set1_epi8(15)));
+}
+
+/*
+ * Returns whether no two consecutive letters of a word of at most
+ * kMaxVectorLength letters are on the same wall, and every letter is in the
+ * box. The word is translated to walls twice, once shifted by a letter, and
+ * the two compared byte by byte. Reads kMaxVectorLength + 1 bytes of text.
+ */
+__attribute__((target("sse4.2")))
+static inline bool wallsAlternate(__m128i lowWalls, __m128i highWalls,
+                                  const char *text, size_t length) {
+    __m128i wall = toWalls(lowWalls, highWalls, text);
+    __m128i next = toWalls(lowWalls, highWalls, text + 1);
+    uint32_t missing = _mm_movemask_epi8(
+        _mm_cmpeq_epi8(wall, _mm_set1_epi8(char(LetterBox::kNone))));
+    uint32_t repeated = _mm_movemask_epi8(_mm_cmpeq_epi8(wall, next));
+
+    uint32_t letters = (uint32_t(1) << length) - 1;
+    return ((missing & letters) | (repeated & (letters >> 1))) == 0;
+}
+
+/* Appends the entry if its word passes the wall test. */
+__attribute__((target("sse4.2")))
+static inline void checkWalls(const DictionaryIndex &dictionary,
+                              const LetterBox &letterBox,
+                              __m128i lowWalls, __m128i highWalls,
+                              const Entry *entry,
+                              std::vector<const Entry *> &matches) {
+    const char *text = dictionary.text(*entry);
+    size_t length = entry->length;
+    if (length < LetterBox::kMinWordLength) return;
+
+    bool passes = length <= kMaxVectorLength
+                  ? wallsAlternate(lowWalls, highWalls, text, length)
+                  : letterBox.canMakeWord(text, length);
+    if (passes) matches.push_back(entry);
+}
+
+/* Appends the words of [begin, end) that pass, four masks at a time. */
+__attribute__((target("sse4.2")))
+static void filterSse42(const DictionaryIndex &dictionary,
+                        const LetterBox &letterBox, uint32_t alphabet,
+                        const uint8_t *walls,
+                        const Entry *begin, const Entry *end,
+                        std::vector<const Entry *> &matches) {
+    const __m128i lowWalls =
+        _mm_load_si128(reinterpret_cast<const __m128i *>(walls));
+    const __m128i highWalls =
+        _mm_load_si128(reinterpret_cast<const __m128i *>(walls + 16));
+    const __m128i outside = _mm_set1_epi32(~alphabet);
+    const __m128i zero = _mm_setzero_si128();
+
+    const uint32_t *masks = dictionary.alphabetMasks() + dictionary.id(*begin);
+    size_t n = end - begin, i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i mask = _mm_loadu_si128(
+            reinterpret_cast<const __m128i *>(masks + i));
+        uint32_t inBox = _mm_movemask_ps(_mm_castsi128_ps(
+            _mm_cmpeq_epi32(_mm_and_si128(mask, outside), zero)));
+        for (; inBox != 0; inBox &= inBox - 1) {
+            checkWalls(dictionary, letterBox, lowWalls, highWalls,
+                       begin + i + __builtin_ctz(inBox), matches);
+        }
+    }
+
+    for (; i < n; i++) {
+        if ((masks[i] & ~alphabet) != 0) continue;
+        checkWalls(dictionary, letterBox, lowWalls, highWalls, begin + i,
+                   matches);
+    }
+}
+
+/* Appends the words of [begin, end) that pass, eight masks at a time. */
+__attribute__((target("avx2")))
+static void filterAvx2(const DictionaryIndex &dictionary,
+                       const LetterBox &letterBox, uint32_t alphabet,
+                       const uint8_t *walls,
+                       const Entry *begin, const Entry *end,
+                       std::vector<const Entry *> &matches) {
+    const __m128i lowWalls =
+        _mm_load_si128(reinterpret_cast<const __m128i *>(walls));
+    const __m128i highWalls =
+        _mm_load_si128(reinterpret_cast<const __m128i *>(walls + 16));
+    const __m256i outside = _mm256_set1_epi32(~alphabet);
+    const __m256i zero = _mm256_setzero_si256();
+
+    const uint32_t *masks = dictionary.alphabetMasks() + dictionary.id(*begin);
+    size_t n = end - begin, i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i mask = _mm256_loadu_si256(
+            reinterpret_cast<const __m256i *>(masks + i));
+        uint32_t inBox = _mm256_movemask_ps(_mm256_castsi256_ps(
+            _mm256_cmpeq_epi32(_mm256_and_si256(mask, outside), zero)));
+        for (; inBox != 0; inBox &= inBox - 1) {
+            checkWalls(dictionary, letterBox, lowWalls, highWalls,
+                       begin + i + __builtin_ctz(inBox), matches);
+        }
+    }
+
+    for (; i < n; i++) {
+        if ((masks[i] & ~alphabet) != 0) continue;
+        checkWalls(dictionary, letterBox, lowWalls, highWalls, begin + i,
+                   matches);
+    }
+}
+
+/* Appends the words of the bucket of a MaskIndex that pass the wall test. */
+__attribute__((target("sse4.2")))
+static void filterBucket(const DictionaryIndex &dictionary,
+                         const LetterBox &letterBox, const MaskIndex &masks,
+                         __m128i lowWalls, __m128i highWalls,
+                         MaskIndex::Bucket bucket,
+                         std::vector<const Entry *> &matches) {
+    for (uint32_t i = bucket.begin; i < bucket.end; i++) {
+        size_t length = masks.length(i);
+        bool passes =
+            length <= kMaxVectorLength
+            ? wallsAlternate(lowWalls, highWalls, masks.text(i), length)
+            : letterBox.canMakeWord(dictionary.text(*masks.entry(i)), length);
+        if (passes) matches.push_back(masks.entry(i));
+    }
+}
+
+#endif
+
+void WordFilter::filter(const DictionaryIndex &dictionary, char first,
+                        std::vector<const Entry *> &matches) const {
+    const Entry *begin = dictionary.begin(first);
+    const Entry *end = dictionary.end(first);
+    if (begin == end) return;
+
+    switch (kernelUsed) {
+#ifdef WORD_FILTER_X86
+        case kAvx2:
+            filterAvx2(dictionary, letterBox, alphabet, walls, begin, end,
+                       matches);
+            return;
+        case kSse42:
+            filterSse42(dictionary, letterBox, alphabet, walls, begin, end,
+                        matches);
+            return;
+#endif
+        default:
+            filterScalar(dictionary, letterBox, alphabet, begin, end,
+                         matches);
+            return;
+    }
+}
+
+void WordFilter::filter(const DictionaryIndex &dictionary,
+                        const MaskIndex &masks,
+                        std::vector<const Entry *> &matches) const {
+#ifdef WORD_FILTER_X86
+    // The wall test only needs 16 byte vectors, so AVX2 adds nothing.
+    if (kernelUsed != kScalar) {
+        const __m128i lowWalls =
+            _mm_load_si128(reinterpret_cast<const __m128i *>(walls));
+        const __m128i highWalls =
+            _mm_load_si128(reinterpret_cast<const __m128i *>(walls + 16));
+        masks.forEachSubset(alphabet, [&](MaskIndex::Bucket bucket) {
+            filterBucket(dictionary, letterBox, masks, lowWalls, highWalls,
+                         bucket, matches);
+        });
+        return;
+    }
+#endif
+    masks.forEachSubset(alphabet, [&](MaskIndex::Bucket bucket) {
+        for (uint32_t i = bucket.begin; i < bucket.end; i++) {
+            const Entry *entry = masks.entry(i);
+            const char *text = dictionary.text(*entry);
+            if (letterBox.canMakeWord(text, entry->length)) {
+                matches.push_back(entry);
+            }
+        }
+    });
+}
@@ -0,0 +1,74 @@
+/*
+ * File: wordfilter.h
+ * Author: Jeremy Ephron
+ * ---------------------
+ * The interface for the WordFilter class, which finds the words of a
+ * DictionaryIndex that can be written within a LetterBox, many words at a
+ * time.
+ *
+ * A word passes if it only uses letters of the box and no two consecutive
+ * letters are on the same wall. The first test runs over the plain array of
+ * alphabet masks of the index, several masks per instruction. The few words
+ * that pass it have their letters translated to wall numbers with a byte
+ * shuffle, and every pair of consecutive letters compared at once.
+ *
+ * The instruction set is picked when the filter is created: AVX2 or SSE4.2
+ * on x86 processors that support them, and plain scalar code otherwise
+ * (which is also used for words too long for a vector register). Every
+ * kernel accepts exactly the words LetterBox::canMakeWord does.
+ */
+
+#ifndef Word_Filter
+#define Word_Filter
+
+#include <cstdint>
+#include <vector>
+#include "dictionaryindex.h"
+#include "letterbox.h"
+#include "maskindex.h"
+
+class WordFilter {
+public:  /* Interface */
+
+    /** The instruction sets a filter can run on. */
+    enum Kernel { kScalar, kSse42, kAvx2 };
+
+    /** Prepares to filter words for a letter box, on the best kernel. */
+    WordFilter(const LetterBox &letterBox);
+
+    /** Prepares to filter words for a letter box, on a given kernel. */
+    WordFilter(const LetterBox &letterBox, Kernel kernel);
+
+    /**
+     * Appends every entry of the dictionary starting with first that can be
+     * written within the letter box to matches, in index order.
+     */
+    void filter(const DictionaryIndex &dictionary, char first,
+                std::vector<const DictionaryIndex::Entry *> &matches) const;
+
+    /**
+     * Appends every entry of the dictionary that can be written within the
+     * letter box to matches, bucket by bucket, looking only at the words a
+     * MaskIndex of the dictionary finds to use letters of the box.
+     */
+    void filter(const DictionaryIndex &dictionary, const MaskIndex &masks,
+                std::vector<const DictionaryIndex::Entry *> &matches) const;
+
+    /** Returns the kernel the filter runs on. */
+    Kernel kernel() const;
+
+    /** Returns the best kernel the processor supports. */
+    static Kernel bestKernel();
+
+private:
+
+    const LetterBox &letterBox;
+    Kernel kernelUsed;
+    uint32_t alphabet;
+
+    // The wall of 'A' + i, or LetterBox::kNone, as two 16-byte halves of a
+    // shuffle table.
+    alignas(16) uint8_t walls[32];
+};
+
+#endif
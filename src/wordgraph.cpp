@@ -0,0 +1,102 @@
+/*
+ * File: wordgraph.cpp
+ * Author: Jeremy Ephron
+ * ---------------------
+ * The implementation of the WordGraph class.
+ */
+
+#include "wordgraph.h"
+
+#include <algorithm>
+#include <tuple>
+
+WordGraph::WordGraph(const LetterBox &letterBox,
+                     const WordTable &wordsStartingWith)
+    : offsets(letterBox.numLetters() + 1, 0), full(letterBox.fullMask()) {
+    const std::string &letters = letterBox.getLetters();
+    std::vector<std::vector<const Word *> > groups(letters.size());
+    for (const Word &word : wordsStartingWith) {
+        groups[letterBox.letterIndex(word[0])].push_back(&word);
+    }
+
+    auto lastOf = [&](const Word *word) {
+        return letterBox.letterIndex(word->back());
+    };
+
+    for (size_t first = 0; first < letters.size(); first++) {
+        offsets[first] = nodes.size();
+
+        std::vector<const Word *> &group = groups[first];
+        std::sort(group.begin(), group.end(),
+                  [&](const Word *lhs, const Word *rhs) {
+            auto lhsKey = std::make_tuple(lastOf(lhs), lhs->mask);
+            auto rhsKey = std::make_tuple(lastOf(rhs), rhs->mask);
+            if (lhsKey != rhsKey) return lhsKey < rhsKey;
+
+            int order = lhs->compare(*rhs);
+            return order != 0 ? order < 0 : lhs->id < rhs->id;
+        });
+
+        for (const Word *word : group) {
+            // A word listed twice in the dictionary is only kept once.
+            if (!members.empty() && nodes.size() > offsets[first] &&
+                *members.back() == *word) {
+                continue;
+            }
+
+            uint8_t last = lastOf(word);
+            if (nodes.size() == offsets[first] || nodes.back().last != last ||
+                nodes.back().mask != word->mask) {
+                Node node;
+                node.mask = word->mask;
+                node.last = last;
+                node.minLength = UINT8_MAX;
+                node.begin = members.size();
+                nodes.push_back(node);
+            }
+
+            size_t length = std::min<size_t>(word->size(), UINT8_MAX);
+            nodes.back().minLength = std::min<size_t>(nodes.back().minLength,
+                                                      length);
+            members.push_back(word);
+            nodes.back().end = members.size();
+        }
+    }
+    offsets[letters.size()] = nodes.size();
+}
+
+const WordGraph::Node *WordGraph::begin(size_t first) const {
+    return this->nodes.data() + this->offsets[first];
+}
+
+const WordGraph::Node *WordGraph::end(size_t first) const {
+    return this->nodes.data() + this->offsets[first + 1];
+}
+
+const WordGraph::Node *WordGraph::begin() const {
+    return this->nodes.data();
+}
+
+const WordGraph::Node *WordGraph::end() const {
+    return this->nodes.data() + this->nodes.size();
+}
+
+const Word *const *WordGraph::words(const Node &node) const {
+    return this->members.data() + node.begin;
+}
+
+size_t WordGraph::size() const {
+    return this->nodes.size();
+}
+
+size_t WordGraph::numWords() const {
+    return this->members.size();
+}
+
+size_t WordGraph::numLetters() const {
+    return this->offsets.size() - 1;
+}
+
+LetterMask WordGraph::fullMask() const {
+    return this->full;
+}
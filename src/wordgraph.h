@@ -0,0 +1,76 @@
+/*
+ * File: wordgraph.h
+ * Author: Jeremy Ephron
+ * ---------------------
+ * The interface for the WordGraph class, a flat, read-only layout of the
+ * filtered words of a puzzle that every search runs on.
+ *
+ * Words with the same first letter, last letter and letter mask are
+ * interchangeable in any solution, so they are collapsed into a single node
+ * (an equivalence class) and the search runs over nodes. The words of a node
+ * are only expanded when solutions are produced.
+ *
+ * Nodes are grouped CSR style by the dense index of their first letter: the
+ * nodes starting with letter i are [offsets[i], offsets[i + 1]). Each node
+ * holds everything the search needs to chain it, so every level of the
+ * search walks one contiguous span. Nodes and the words within a node are
+ * sorted, and a word the dictionary lists twice is kept once.
+ */
+
+#ifndef Word_Graph
+#define Word_Graph
+
+#include <cstdint>
+#include <vector>
+#include "letterbox.h"
+#include "word.h"
+
+class WordGraph {
+public:  /* Interface */
+
+    /** A class of words sharing first letter, last letter and mask. */
+    struct Node {
+        LetterMask mask;
+        uint8_t last;       // dense index of the last letter
+        uint8_t minLength;  // length of the shortest word of the class
+        uint32_t begin;     // the words of the class are words()[begin, end)
+        uint32_t end;
+
+        size_t size() const { return end - begin; }
+    };
+
+    /** Lays out the words of a filtered word table. */
+    WordGraph(const LetterBox &letterBox, const WordTable &wordsStartingWith);
+
+    /** Returns the range of nodes of words starting with a letter index. */
+    const Node *begin(size_t first) const;
+    const Node *end(size_t first) const;
+
+    /** Returns the range of all nodes. */
+    const Node *begin() const;
+    const Node *end() const;
+
+    /** Returns the words of a node. */
+    const Word *const *words(const Node &node) const;
+
+    /** Returns the number of nodes in the graph. */
+    size_t size() const;
+
+    /** Returns the number of words in the graph. */
+    size_t numWords() const;
+
+    /** Returns the number of letters of the box the graph was built for. */
+    size_t numLetters() const;
+
+    /** Returns the mask with every letter of the box set. */
+    LetterMask fullMask() const;
+
+private:
+
+    std::vector<Node> nodes;
+    std::vector<uint32_t> offsets;
+    std::vector<const Word *> members;
+    LetterMask full;
+};
+
+#endif
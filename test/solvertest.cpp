@@ -0,0 +1,181 @@
+/*
+ * File: solvertest.cpp
+ * Author: Jeremy Ephron
+ * ----------------------
+ * Checks of the Solver class of libletterboxed, run by "make test" from the
+ * build folder, where the default dictionary index is.
+ *
+ * Each check prints what it expected when it fails, and the program exits
+ * with status 1 if any did.
+ */
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include "dictionaryindex.h"
+#include "puzzlecache.h"
+#include "search.h"
+#include "solutionset.h"
+#include "solver.h"
+#include "taskpool.h"
+
+static const std::string kDictionary = "dictionary.idx";
+static const std::string kLetters = "GIYHCTLAOPRE";
+static const unsigned int kWords = 2;
+static const unsigned int kShards = 3;
+
+static int nFailed = 0;
+
+/**
+ * Function: expectEqual
+ * ---------------------
+ * Counts a check as failed, printing both values, unless they are equal.
+ *
+ * @param what the name of the check.
+ * @param actual the value found.
+ * @param expected the value expected.
+ */
+static void expectEqual(const std::string &what, uint64_t actual,
+                        uint64_t expected) {
+    if (actual == expected) return;
+    std::cerr << "FAILED " << what << ": got " << actual << ", expected "
+              << expected << std::endl;
+    nFailed++;
+}
+
+/**
+ * Function: countSolutions
+ * ------------------------
+ * Solves the test puzzle, sharded if nShards is above one, and returns the
+ * number of solutions passed to the callback.
+ *
+ * @param solver the solver to use.
+ * @param shard the shard to search.
+ * @param nShards the number of shards, 1 for the whole search.
+ * @returns the number of solutions, checked against the one solve() reports.
+ */
+static uint64_t countSolutions(Solver &solver, unsigned int shard,
+                               unsigned int nShards) {
+    SearchOptions options;
+    options.shard = shard;
+    options.nShards = nShards;
+
+    uint64_t nSeen = 0, nFound = 0;
+    std::string error;
+    if (!solver.solve(kLetters, kWords, options,
+                      [&nSeen](const Word *const *, unsigned int) {
+                          nSeen++;
+                      }, nFound, error)) {
+        std::cerr << "FAILED solve: " << error << std::endl;
+        nFailed++;
+    }
+    expectEqual("reported count", nFound, nSeen);
+    return nSeen;
+}
+
+/**
+ * Function: countCached
+ * ---------------------
+ * Solves the test puzzle through a PuzzleCache directly, sharded if nShards
+ * is above one, and returns the number of solutions passed to the consumer.
+ *
+ * @param cache the cache to use.
+ * @param pool the pool to search on.
+ * @param shard the shard to search.
+ * @param nShards the number of shards, 1 for the whole search.
+ * @returns the number of solutions, checked against the one solve() returns.
+ */
+static uint64_t countCached(PuzzleCache &cache, TaskPool &pool,
+                            unsigned int shard, unsigned int nShards) {
+    SearchOptions options;
+    options.shard = shard;
+    options.nShards = nShards;
+
+    uint64_t nSeen = 0;
+    uint64_t nFound = cache.solve(kLetters, kWords, options, pool,
+                                  [&nSeen](const SolutionSet &batch) {
+                                      nSeen += batch.size();
+                                  });
+    expectEqual("returned count", nFound, nSeen);
+    return nSeen;
+}
+
+/**
+ * Function: testShardsWithWarmCache
+ * ---------------------------------
+ * Checks that a sharded search finds the solutions of its shard only, the
+ * same as without a cache, after the whole search has been cached, and that
+ * the shards do not take the place of the whole search in the cache.
+ */
+static void testShardsWithWarmCache() {
+    Solver uncached(kDictionary);
+    Solver cached(kDictionary, 0, 16);
+    if (!uncached.isOpen() || !cached.isOpen()) {
+        std::cerr << "FAILED could not load \"" << kDictionary << "\""
+                  << std::endl;
+        nFailed++;
+        return;
+    }
+
+    uint64_t nAll = countSolutions(uncached, 0, 1);
+    expectEqual("cold full search", countSolutions(cached, 0, 1), nAll);
+    expectEqual("warm full search", countSolutions(cached, 0, 1), nAll);
+
+    uint64_t nSharded = 0;
+    for (unsigned int shard = 0; shard < kShards; shard++) {
+        uint64_t nShard = countSolutions(uncached, shard, kShards);
+        std::string name = "shard " + std::to_string(shard) + "/" +
+                           std::to_string(kShards);
+        expectEqual(name + " with a warm cache",
+                    countSolutions(cached, shard, kShards), nShard);
+        nSharded += nShard;
+    }
+    expectEqual("sum of the shards", nSharded, nAll);
+    expectEqual("full search after the shards", countSolutions(cached, 0, 1),
+                nAll);
+}
+
+/**
+ * Function: testCacheShards
+ * -------------------------
+ * Checks that a PuzzleCache searches a shard on the box as given, rather
+ * than on its canonical box, whose tasks are numbered otherwise, and that
+ * it neither answers a shard from the cache nor caches one.
+ */
+static void testCacheShards() {
+    DictionaryIndex dictionary(kDictionary);
+    Solver uncached(kDictionary);
+    if (!dictionary.isOpen() || !uncached.isOpen()) {
+        std::cerr << "FAILED could not load \"" << kDictionary << "\""
+                  << std::endl;
+        nFailed++;
+        return;
+    }
+    PuzzleCache cache(dictionary, 16);
+    TaskPool pool;
+
+    uint64_t nAll = countCached(cache, pool, 0, 1);
+    expectEqual("cached full search", nAll, countSolutions(uncached, 0, 1));
+
+    for (unsigned int shard = 0; shard < kShards; shard++) {
+        std::string name = "cached shard " + std::to_string(shard) + "/" +
+                           std::to_string(kShards);
+        uint64_t nShard = countSolutions(uncached, shard, kShards);
+        expectEqual(name, countCached(cache, pool, shard, kShards), nShard);
+        expectEqual(name + " again", countCached(cache, pool, shard, kShards),
+                    nShard);
+    }
+    expectEqual("cache hits", cache.numHits(), 0);
+    expectEqual("cached full search after the shards",
+                countCached(cache, pool, 0, 1), nAll);
+    expectEqual("cache hits after the shards", cache.numHits(), 1);
+}
+
+int main() {
+    testShardsWithWarmCache();
+    testCacheShards();
+    if (nFailed != 0) return 1;
+
+    std::cout << "All checks passed." << std::endl;
+    return 0;
+}